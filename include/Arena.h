@@ -0,0 +1,102 @@
+//
+//  Arena.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Hands out memory by carving it off the end of chunks. Nothing is given back
+// until the arena itself goes away, which makes it a good fit for lots of
+// small objects that are built together and thrown away together, like the
+// lots of a block. Chunks start small and double up to maxChunkSize so an
+// arena that only holds a few objects only takes a little memory. Only use
+// it from one thread at a time.
+class Arena {
+  public:
+    static std::shared_ptr<Arena> create( size_t firstChunkSize = 1024, size_t maxChunkSize = 64 * 1024 )
+    {
+        return std::make_shared<Arena>( firstChunkSize, maxChunkSize );
+    }
+
+    Arena( size_t firstChunkSize, size_t maxChunkSize )
+        : mChunkSize( firstChunkSize ), mMaxChunkSize( maxChunkSize ) {};
+    ~Arena();
+
+    Arena( const Arena& ) = delete;
+    Arena& operator=( const Arena& ) = delete;
+
+    void*   allocate( size_t size, size_t alignment );
+    size_t  bytesAllocated() const { return mBytesAllocated; }
+
+    // The arena makeShared() uses on this thread, null when there isn't one.
+    static std::shared_ptr<Arena> current();
+
+    // Makes an arena current on this thread for as long as it's in scope.
+    class Scope {
+      public:
+        Scope( const std::shared_ptr<Arena> &arena );
+        ~Scope();
+
+        Scope( const Scope& ) = delete;
+        Scope& operator=( const Scope& ) = delete;
+
+      private:
+        friend class Arena;
+        std::shared_ptr<Arena>  mArena;
+        Scope                   *mPrevious;
+    };
+
+  private:
+    // The size of the next chunk.
+    size_t              mChunkSize;
+    size_t              mMaxChunkSize;
+    std::vector<char*>  mChunks;
+    char                *mNext = nullptr;
+    char                *mEnd = nullptr;
+    size_t              mBytesAllocated = 0;
+};
+
+// Lets std::allocate_shared put an object in an arena. Each object holds on
+// to the arena so it's only freed once everything in it is gone.
+template<class T>
+class ArenaAllocator {
+  public:
+    typedef T value_type;
+
+    ArenaAllocator( const std::shared_ptr<Arena> &arena ) : mArena( arena ) {};
+    template<class U>
+    ArenaAllocator( const ArenaAllocator<U> &other ) : mArena( other.mArena ) {};
+
+    T* allocate( size_t n )
+    {
+        return static_cast<T*>( mArena->allocate( n * sizeof( T ), alignof( T ) ) );
+    }
+    void deallocate( T*, size_t ) {}
+
+    template<class U>
+    bool operator==( const ArenaAllocator<U> &other ) const { return mArena == other.mArena; }
+    template<class U>
+    bool operator!=( const ArenaAllocator<U> &other ) const { return mArena != other.mArena; }
+
+  private:
+    template<class U> friend class ArenaAllocator;
+    std::shared_ptr<Arena> mArena;
+};
+
+// Like std::make_shared but puts the object in the current arena if there is
+// one.
+template<class T, class... Args>
+std::shared_ptr<T> makeShared( Args&&... args )
+{
+    std::shared_ptr<Arena> arena = Arena::current();
+    if ( arena ) {
+        return std::allocate_shared<T>( ArenaAllocator<T>( arena ), std::forward<Args>( args )... );
+    }
+    return std::make_shared<T>( std::forward<Args>( args )... );
+}
@@ -42,8 +42,15 @@ struct BuildingSettings {
     RoofStyle roofStyle = RoofStyle::FLAT;
     float slope = 0.5f;
     float overhang = 0.0f;
+
+    bool operator==( const BuildingSettings &o ) const {
+        return floors == o.floors && roofStyle == o.roofStyle && slope == o.slope && overhang == o.overhang;
+    }
 };
 ci::geom::SourceMods buildingGeometry( const ci::PolyLine2f &outline, const BuildingSettings &settings );
+// A stand in for when the building is far off: the outline's convex hull
+// walled up to the eaves with a flat top. No roof, no overhang.
+ci::geom::SourceMods buildingProxyGeometry( const ci::PolyLine2f &outline, const BuildingSettings &settings );
 
 
 class BuildingPlan : public Scenery {
@@ -55,16 +62,20 @@ class BuildingPlan : public Scenery {
         settings.roofStyle = roofStyle;
         settings.slope = slope;
         settings.overhang = overhang;
-        return SceneryRef( new BuildingPlan( outline, buildingGeometry( outline, settings) ) );
+        return create( outline, settings );
     }
 
+    // The proxy is the plan's simpler level of detail.
     static SceneryRef create( const ci::PolyLine2f &outline, const BuildingSettings &settings )
     {
-        return SceneryRef( new BuildingPlan( outline, buildingGeometry( outline, settings) ) );
+        return SceneryRef( new BuildingPlan( outline, std::vector<ci::geom::SourceMods>{ buildingGeometry( outline, settings ), buildingProxyGeometry( outline, settings ) } ) );
     }
 
     BuildingPlan( const ci::PolyLine2f &outline, const ci::geom::SourceMods &geometry )
       : Scenery( outline, geometry ) {}
+
+    BuildingPlan( const ci::PolyLine2f &outline, const std::vector<ci::geom::SourceMods> &levels )
+      : Scenery( outline, levels ) {}
 };
 
 // Builds a layer cake style of building given a foot print then list of heights and contractions for the next layer
@@ -0,0 +1,60 @@
+//
+//  BuildingPlanCache.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "BuildingPlan.h"
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+// Hands out the same BuildingPlan for the same outline and settings rather than
+// rebuilding the geometry every time. Outlines match if their points are
+// within a hundredth of each other, see outlinesMatch(), so the floating point
+// noise left by canonicalOutline() doesn't keep copies apart. Safe to use from
+// multiple threads. The least recently used plans are dropped once it's over
+// capacity, anyone still holding one keeps it alive.
+class BuildingPlanCache {
+  public:
+    // The one shared across the process.
+    static BuildingPlanCache& shared();
+
+    BuildingPlanCache( size_t capacity = 4096 ) : mCapacity( capacity ) {};
+
+    SceneryRef plan( const ci::PolyLine2f &outline, const BuildingSettings &settings );
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t evictions = 0;
+        size_t size = 0;
+    };
+    Stats stats();
+
+    void setCapacity( size_t capacity );
+    void clear();
+
+  private:
+    struct Entry {
+        uint32_t                hash;
+        std::vector<ci::vec2>   points;
+        BuildingSettings        settings;
+        SceneryRef              plan;
+    };
+    typedef std::list<Entry> EntryList;
+
+    // Caller must hold mMutex.
+    SceneryRef find( const std::vector<uint32_t> &hashes, const std::vector<ci::vec2> &points, const BuildingSettings &settings );
+    void trim();
+
+    std::mutex  mMutex;
+    size_t      mCapacity;
+    // Most recently used at the front.
+    EntryList   mEntries;
+    std::unordered_multimap<uint32_t, EntryList::iterator> mIndex;
+    Stats       mStats;
+};
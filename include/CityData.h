@@ -7,6 +7,8 @@
 //
 #pragma once
 
+#include "Arena.h"
+
 class FlatShape;
 typedef std::shared_ptr<FlatShape>  FlatShapeRef;
 
@@ -16,6 +18,8 @@ typedef std::shared_ptr<Blueprint>  BlueprintRef;
 class Scenery;
 typedef std::shared_ptr<const Scenery>  SceneryRef;
 
+struct InstanceTable;
+
 class Scenery : public std::enable_shared_from_this<Scenery> {
   public:
     static ci::mat4 buildMatrix( const ci::vec3 &position = ci::vec3( 0 ), float rotation = 0, const ci::mat4 &input = ci::mat4() )
@@ -35,7 +39,7 @@ class Scenery : public std::enable_shared_from_this<Scenery> {
         }
 
         Instance( const Instance& other )
-            : scenery( other.scenery ), transformation( other.transformation ), color( other.color), children( other.children )
+            : scenery( other.scenery ), transformation( other.transformation ), color( other.color)
         {};
         Instance( const SceneryRef &scenery, const ci::mat4 &matrix, const ci::ColorA &color )
             : scenery( scenery ), transformation( matrix ), color( color )
@@ -50,16 +54,26 @@ class Scenery : public std::enable_shared_from_this<Scenery> {
         SceneryRef              scenery;
         ci::mat4                transformation;
         ci::ColorA              color;
-        std::vector<Instance>   children;
     };
 
     Scenery( const ci::PolyLine2f &footprint, const ci::geom::SourceMods &geometry )
         : mFootprint( footprint ), mGeometry( geometry ) {};
+    // Levels of detail, most detailed first.
+    Scenery( const ci::PolyLine2f &footprint, const std::vector<ci::geom::SourceMods> &levels )
+        : mFootprint( footprint ), mGeometry( levels.front() ), mSimpler( levels.begin() + 1, levels.end() ) {};
 
     // 2d view of the object for collsion detection
     const ci::PolyLine2f footprint() const { return mFootprint; };
     // 3d view of the object for display
     const ci::geom::SourceMods &geometry() const { return mGeometry; };
+    // Cheaper versions to draw when it's further away. Level 0 is geometry(),
+    // asking for more levels than there are gives the simplest one.
+    size_t levelsOfDetail() const { return 1 + mSimpler.size(); }
+    const ci::geom::SourceMods &geometry( size_t level ) const
+    {
+        if ( level == 0 || mSimpler.empty() ) return mGeometry;
+        return mSimpler[ std::min( level, mSimpler.size() ) - 1 ];
+    }
 
     Scenery::Instance instance( const ci::vec2 &at, float rotation = 0 ) const
     {
@@ -74,9 +88,18 @@ class Scenery : public std::enable_shared_from_this<Scenery> {
         return Scenery::Instance( shared_from_this(), matrix, color );
     }
 
+    // Puts an instance of this in the table. Groups put in their parts
+    // instead so the table only ever holds things that can be drawn.
+    virtual void addTo( InstanceTable &table, const ci::mat4 &matrix, const ci::ColorA &color ) const;
+
   protected:
-    ci::PolyLine2f          mFootprint;
-    ci::geom::SourceMods    mGeometry;
+    // Builds a round shape at its full number of subdivisions, then at half
+    // and a quarter of that, stopping at 3.
+    static std::vector<ci::geom::SourceMods> roundLevels( u_int8_t subdivisions, const std::function<ci::geom::SourceMods( u_int8_t )> &build );
+
+    ci::PolyLine2f                      mFootprint;
+    ci::geom::SourceMods                mGeometry;
+    std::vector<ci::geom::SourceMods>   mSimpler;
 };
 
 class SceneryGroup : public Scenery {
@@ -107,15 +130,53 @@ class SceneryGroup : public Scenery {
     SceneryGroup( const std::vector<Item> &items );
     SceneryGroup( const std::vector<Item> &items, const ci::PolyLine2f &footprint );
 
-    virtual Scenery::Instance instance( const ci::mat4 &matrix, const ci::ColorA &color = ci::ColorA::white() ) const override;
+    virtual void addTo( InstanceTable &table, const ci::mat4 &matrix, const ci::ColorA &color ) const override;
 
     const std::vector<Item> items;
 };
 
+// Placed scenery kept as parallel arrays, one entry per instance, so drawing
+// code can walk or copy out a column without chasing pointers.
+struct InstanceTable {
+    // Groups are expanded into their parts as they're added.
+    void add( const Scenery::Instance &instance )
+    {
+        instance.scenery->addTo( *this, instance.transformation, instance.color );
+    }
+    // Adds exactly this, no expansion.
+    void append( const SceneryRef &s, const ci::mat4 &transform, const ci::ColorA &color )
+    {
+        scenery.push_back( s );
+        transforms.push_back( transform );
+        colors.push_back( color );
+    }
+
+    size_t  size() const { return scenery.size(); }
+    bool    empty() const { return scenery.empty(); }
+    void    clear()
+    {
+        scenery.clear();
+        transforms.clear();
+        colors.clear();
+    }
+
+    std::vector<SceneryRef> scenery;
+    std::vector<ci::mat4>   transforms;
+    std::vector<ci::ColorA> colors;
+};
+
 
 namespace Cityscape {
-    // Give relatively unique colors
+    // Give relatively unique colors. Safe to call from any thread, but the
+    // order colors come out in then depends on scheduling. When that matters
+    // use the indexed version.
     ci::ColorA colorWheel();
+    ci::ColorA colorWheel( size_t index );
+
+    // Mix the city's seed with a stable ID for one piece of it, like
+    // FlatShape::hash(), to seed that piece's own ci::Rand. The results then
+    // don't depend on the order the pieces are visited in.
+    uint32_t seedFor( uint32_t citySeed, uint32_t id );
 
     class  LotDeveloper;
     struct ZoningPlan;
@@ -160,7 +221,16 @@ namespace Cityscape {
                 int16_t streetAngle = 90; // -90 - +90 degrees
                 uint16_t avenueSpacing = 200;
                 uint16_t streetSpacing = 300;
+
+                bool operator==( const GridOptions &o ) const {
+                    return roadWidth == o.roadWidth && avenueAngle == o.avenueAngle && streetAngle == o.streetAngle
+                        && avenueSpacing == o.avenueSpacing && streetSpacing == o.streetSpacing;
+                }
             } grid;
+
+            bool operator==( const DistrictOptions &o ) const {
+                return streetDivision == o.streetDivision && grid == o.grid;
+            }
         } district;
 
         struct BlockOptions {
@@ -168,6 +238,11 @@ namespace Cityscape {
             uint16_t lotWidth = 40;
             uint32_t lotAreaMin = 1000;
             uint32_t lotAreaMax = 40000;
+
+            bool operator==( const BlockOptions &o ) const {
+                return lotDivision == o.lotDivision && lotWidth == o.lotWidth
+                    && lotAreaMin == o.lotAreaMin && lotAreaMax == o.lotAreaMax;
+            }
         } block;
 
         // TODO Think of a better name for this
@@ -178,20 +253,44 @@ namespace Cityscape {
 
             LotDeveloperRef developer;
             uint8_t         ratio = 1;
+
+            bool operator==( const LotUsage &o ) const {
+                return developer == o.developer && ratio == o.ratio;
+            }
         };
         std::vector<LotUsage> lotUsages;
 
         void addUsage( const LotDeveloperRef &developer, uint8_t ratio = 1 ) {
             lotUsages.push_back( LotUsage( developer, ratio ) );
         }
+
+        // Same settings, the name doesn't count.
+        bool operator==( const ZoningPlan &o ) const {
+            return district == o.district && block == o.block && lotUsages == o.lotUsages;
+        }
+        bool operator!=( const ZoningPlan &o ) const { return !( *this == o ); }
     };
 
+    // Hashes of the settings each stage builds from. Each piece of the city
+    // records the key it was built with so the pipeline can skip work that's
+    // still good and pick up at the first stage whose inputs changed. A match
+    // is trusted without looking at the settings so they're 64 bits to keep
+    // collisions out of reach. Zero is reserved for "not built yet".
+    struct CityModel;
+    uint64_t highwaysKeyFor( const CityModel &city );
+    uint64_t streetsKeyFor( const ZoningPlan &plan );
+    uint64_t lotsKeyFor( const ZoningPlan &plan, uint32_t seed );
+    uint64_t sceneryKeyFor( const ZoningPlan &plan, uint32_t seed );
+
     // * * *
 
     struct CityModel {
         CityModel();
         CityModel( const std::vector<ZoningPlanRef> &zoning) : zoningPlans( zoning ) {}
 
+        // Everything random about the city is derived from this.
+        uint32_t    seed = 1;
+
         ci::Rectf   dimensions = ci::Rectf( -600, -600, 600, 600 );
         ci::Color   groundColor = ci::Color8u(233, 203, 151);
 
@@ -204,6 +303,9 @@ namespace Cityscape {
 
         std::vector<ZoningPlanRef>  zoningPlans;
         std::vector<DistrictRef>    districts;
+
+        // The highways and width the pavement and districts were built from.
+        uint64_t                    highwaysKey = 0;
     };
 
     // * * *
@@ -248,32 +350,40 @@ namespace Cityscape {
     struct District : public Ground {
         static DistrictRef create( const FlatShapeRef &s, const ZoningPlanRef &zp )
         {
-            return std::make_shared<District>( s, zp );
+            return makeShared<District>( s, zp );
         };
 
         using Ground::Ground;
         District( const FlatShapeRef &s, const ZoningPlanRef &zp ) : Ground( s ), zoningPlan( zp ) {};
 
-        ZoningPlanRef           zoningPlan;
-        std::vector<BlockRef>   blocks;
+        ZoningPlanRef               zoningPlan;
+        // Side streets from the grid, the highways are in CityModel::pavement.
+        std::vector<FlatShapeRef>   pavement;
+        std::vector<BlockRef>       blocks;
+        // streetsKeyFor() the plan the pavement and blocks came from.
+        uint64_t                    streetsKey = 0;
     };
 
     struct Block : public Ground {
-        static BlockRef create( const FlatShapeRef &s ) { return std::make_shared<Block>( s ); };
+        static BlockRef create( const FlatShapeRef &s ) { return makeShared<Block>( s ); };
 
         using Ground::Ground;
 
         std::vector<LotRef>     lots;
+        // lotsKeyFor() the plan the lots came from.
+        uint64_t                lotsKey = 0;
     };
 
     struct Lot : public Ground {
-        static LotRef create( const FlatShapeRef &s ) { return std::make_shared<Lot>( s ); };
+        static LotRef create( const FlatShapeRef &s ) { return makeShared<Lot>( s ); };
 
         using Ground::Ground;
 
         std::vector<seg2> streetFacingSides;
-        std::vector<Scenery::Instance> buildings;
-        std::vector<Scenery::Instance> plants;
+        InstanceTable buildings;
+        InstanceTable plants;
+        // sceneryKeyFor() the plan the buildings and plants came from.
+        uint64_t sceneryKey = 0;
     };
 
 } // Cityscape namespace
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Mode.h"
+#include "LayoutWorker.h"
 
 class CityMode : public BaseMode
 {
@@ -8,6 +9,7 @@ class CityMode : public BaseMode
     virtual void setup() override;
     virtual void addParams( ci::params::InterfaceGlRef params ) override;
     virtual void layout() override;
+    virtual void update( double elapsed ) override;
 
     virtual std::vector<ci::vec2> getPoints() override;
     virtual void addPoint( ci::vec2 point ) override;
@@ -19,4 +21,6 @@ class CityMode : public BaseMode
   private:
     std::vector<ci::PolyLine2> mHighways;
     bool isAddingRoad = false;
+
+    Cityscape::LayoutWorker mLayoutWorker;
 };
@@ -0,0 +1,39 @@
+//
+//  CityPipeline.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "CityData.h"
+
+namespace Cityscape {
+    // One step of turning highways into a developed city. They need to be run
+    // in the order pipelineStages() returns them.
+    struct PipelineStage {
+        PipelineStage( const std::string &name, const std::function<void(CityModel&)> &run )
+            : name( name ), run( run ) {};
+
+        std::string name;
+        std::function<void(CityModel&)> run;
+    };
+
+    // Highways -> Districts -> Blocks -> Lots -> Buildings
+    const std::vector<PipelineStage>& pipelineStages();
+
+    // Runs every stage in order.
+    void runPipeline( CityModel &city );
+
+    struct CityStats {
+        size_t districts = 0;
+        size_t blocks = 0;
+        size_t lots = 0;
+        size_t buildings = 0;
+        size_t plants = 0;
+    };
+    CityStats statsFor( const CityModel &city );
+
+    // High water mark of the process's resident memory in bytes.
+    size_t peakMemoryUsage();
+}
@@ -9,22 +9,140 @@
 #pragma once
 
 #include "CityData.h"
+#include "GpuResources.h"
+#include "InstanceData.h"
+
+#include "cinder/AxisAlignedBox.h"
+
+#include <map>
 
 class CityView;
 typedef std::shared_ptr<CityView>   CityViewRef;
 
 class CityView {
 public:
-    struct InstanceData {
-        InstanceData( const ci::mat4 &mv, const ci::vec4 &c )
-            : modelView( mv ), color( c ) {};
+    // One kind of scenery, drawn instanced.
+    struct InstanceBatch {
+        // One per level of detail the scenery has, most detailed first.
+        struct Level {
+            // Only for batches with full matrices, the rest are drawn by
+            // an IndirectPass.
+            ci::gl::BatchRef    batch;
+            // Per instance data with the ones drawn at this level packed at
+            // the front of its slice, starting at firstInstance.
+            ci::gl::VboRef      vbo;
+            size_t              firstInstance = 0;
+            // How many at the front of the slice to draw.
+            mutable GLsizei     visible = 0;
+            // Where it is in the shared geometry, for an IndirectPass.
+            GpuResources::PackedMesh mesh;
+        };
+
+        // Adds an instance to the end, switching the batch over to full
+        // matrices if it won't pack.
+        void add( const ci::mat4 &transform, const ci::ColorA &color );
+        // Moves other's instances onto the end, in whichever format fits
+        // both.
+        void append( InstanceBatch &&other );
+        void makeFull();
+        size_t size() const { return fullMatrices ? fullInstances.size() : instances.size(); }
+
+        // What it draws.
+        SceneryRef                  scenery;
+        std::vector<Level>          levels;
+        // Every instance, grouped by lot. Lots that have been removed leave
+        // gaps until there are enough to be worth compacting.
+        std::vector<InstanceData>   instances;
+        // Once any instance needs a whole matrix they all get one, and live
+        // here instead of instances.
+        bool                        fullMatrices = false;
+        std::vector<FullInstanceData> fullInstances;
+        // How many instances belong to removed lots.
+        size_t                      freed = 0;
+        // How many instances the level buffers have room for.
+        size_t                      capacity = 0;
+    };
+
+    // A district, block or lot. Scenery is culled against the camera a node
+    // at a time, and the children of nodes that are out of view are skipped.
+    struct CullNode {
+        // Where some of a lot's instances are.
+        struct Range {
+            bool        plant;
+            uint32_t    batch;
+            size_t      first;
+            size_t      count;
+        };
+
+        // The district, block or lot it was built from.
+        std::shared_ptr<const void> owner;
+        ci::AxisAlignedBox      bounds;
+        std::vector<CullNode>   children;
+        std::vector<Range>      ranges;
+        // Index into blockProxies for blocks with buildings, -1 otherwise.
+        int32_t                 proxy = -1;
+    };
 
-        ci::mat4 modelView;
-        ci::vec4 color;
+    // All the flat shapes of one kind baked into a single mesh, colors and
+    // height included, so the whole layer draws in one call. The buffers are
+    // bigger than they need to be so updates can add shapes in place.
+    struct GroundLayer {
+        ci::gl::BatchRef    batch;
+        ci::gl::VboRef      positions;
+        ci::gl::VboRef      colors;
+        ci::gl::VboRef      indices;
+        size_t              vertexCapacity = 0;
+        size_t              indexCapacity = 0;
+        size_t              usedVertices = 0;
+        size_t              usedIndices = 0;
+        // Indices of shapes that have been removed, they're zeroed out so
+        // they draw nothing.
+        size_t              freedIndices = 0;
+        // First index and index count for each shape, in the order they were
+        // added, so they can be drawn on their own. Removed ones are left
+        // with no indices.
+        std::vector<std::pair<GLint, GLsizei>> ranges;
+        // Which range belongs to what.
+        std::map<std::shared_ptr<const void>, size_t> slots;
+
+        void draw() const { if ( batch ) batch->draw( 0, usedIndices ); }
+        void drawShape( size_t index ) const { batch->draw( ranges[index].first, ranges[index].second ); }
     };
 
-    // Batch has mesh, instanced data, shader, size is number of instances to render.
-    typedef std::pair<ci::gl::BatchRef, GLsizei> InstanceBatch;
+    // Every level of every packed batch for one shader, drawn in one call.
+    // The meshes come from GpuResources' packed buffers, the instances share
+    // one buffer with a slice per level, and there's a draw command for each
+    // level with something in view. Without multi-draw-indirect the commands
+    // are drawn one at a time instead, which still skips all the per batch
+    // state changes.
+    struct IndirectPass {
+        // Laid out the way glMultiDrawElementsIndirect wants.
+        struct Command {
+            GLuint  count;
+            GLuint  instanceCount;
+            GLuint  firstIndex;
+            GLint   baseVertex;
+            GLuint  baseInstance;
+        };
+
+        void draw() const;
+        // Builds the commands from how many of each level are visible.
+        void setCommands( const std::vector<InstanceBatch> &batches ) const;
+        // Points the instance attributes at the slice starting at first.
+        void pointInstances( GLuint first ) const;
+
+        ci::gl::GlslProgRef     shader;
+        ci::gl::VaoRef          vao;
+        ci::gl::VboRef          positions;
+        ci::gl::VboRef          indices;
+        ci::gl::VboRef          instances;
+        // Only when multi-draw-indirect is available.
+        ci::gl::VboRef          commandBuffer;
+        GLint                   positionLocation = -1;
+        GLint                   axesLocation = -1;
+        GLint                   colorLocation = -1;
+        mutable std::vector<Command> commands;
+    };
 
     struct Options {
         bool drawRoads = true;
@@ -34,23 +152,71 @@ public:
         bool drawLotEdges = false;
         bool drawPlants = true;
         bool drawBuildings = true;
+        // Skip scenery outside the camera's view.
+        bool cullScenery = true;
+        // Scenery with simpler versions steps down a level of detail each
+        // time its lot gets this much further from the camera.
+        float lodDistance = 300;
+        // Past this far from the camera a block's buildings are drawn all at
+        // once from blockProxies instead.
+        float proxyDistance = 600;
+        // Order scenery by distance from the camera, buildings nearest first
+        // and plants furthest first. It's redone when the camera moves more
+        // than resortDistance or turns.
+        bool sortScenery = true;
+        float resortDistance = 25;
     };
 
     static CityViewRef create( const Cityscape::CityModel &cm ) { return CityViewRef( new CityView( cm ) ); }
 
     CityView( const Cityscape::CityModel &model );
 
+    // Brings the view in line with model, which is expected to share most of
+    // its districts, blocks and lots with the last one. Anything that's the
+    // same object as last time is assumed to be unchanged so only the lots
+    // that were added or removed are touched.
+    void update( const Cityscape::CityModel &model );
 
     void draw( const Options &o ) const;
 
     ci::gl::BatchRef              sky;
     ci::gl::BatchRef              ground;
-    std::vector<ci::gl::BatchRef> roads;
-    std::vector<ci::gl::BatchRef> districts;
-    std::vector<ci::gl::BatchRef> blocks;
-    std::vector<ci::gl::BatchRef> lots;
+    GroundLayer                   roads;
+    GroundLayer                   districts;
+    GroundLayer                   blocks;
+    GroundLayer                   lots;
     // TODO: convert the edges to a batch
     std::vector<ci::PolyLine2f> lotEdges;
     std::vector<InstanceBatch> buildings;
     std::vector<InstanceBatch> plants;
+    IndirectPass buildingPass;
+    IndirectPass plantPass;
+    // One node per district.
+    std::vector<CullNode> cullTree;
+    // Every building on a block at its simplest level of detail merged into
+    // one mesh, drawn as a single instance.
+    std::vector<InstanceBatch::Level> blockProxies;
+
+  private:
+    // Packs the instances of the lots in view into the front of the buffer
+    // for the level of detail they're drawn at. Uses the current matrices as
+    // the camera.
+    void cullScenery( const Options &options ) const;
+
+    struct VisibleLot {
+        const CullNode  *node;
+        // How far off it is in steps of lodDistance.
+        uint32_t        level;
+        // Its buildings are drawn by the block's proxy.
+        bool            proxied;
+
+        bool operator==( const VisibleLot &o ) const { return node == o.node && level == o.level && proxied == o.proxied; }
+    };
+    // The lots that were packed last time. Nothing needs uploading until
+    // that changes.
+    typedef std::vector<VisibleLot> VisibleLots;
+    mutable VisibleLots mVisibleLots;
+    // Where the camera was and which way it faced for the last sort.
+    mutable ci::vec3    mSortedEye;
+    mutable ci::vec3    mSortedForward;
 };
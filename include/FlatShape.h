@@ -8,8 +8,12 @@
 
 #pragma once
 
+#include "Arena.h"
 #include "CgalPolygon.h"
 #include "CgalArrangement.h"
+#include "CgalStraightSkeleton.h"
+
+namespace cinder { class Rand; }
 
 typedef std::shared_ptr<class cinder::TriMesh>		TriMeshRef;
 
@@ -23,12 +27,12 @@ class FlatShape {
 
     static FlatShapeRef create( const ci::PolyLine2f &outline, const PolyLine2fs &holes = {} )
     {
-        return std::make_shared<FlatShape>( outline, holes );
+        return makeShared<FlatShape>( outline, holes );
     }
 
     static FlatShapeRef create( const CGAL::Polygon_with_holes_2<ExactK> &pwh )
     {
-        return std::make_shared<FlatShape>( pwh );
+        return makeShared<FlatShape>( pwh );
     }
 
     static FlatShapeRef create( const Arrangement_2::Face_iterator &face )
@@ -38,13 +42,13 @@ class FlatShape {
         for ( auto hole = face->holes_begin(); hole != face->holes_end(); ++hole ) {
             lotHoles.push_back( polyLineFrom( *hole ) );
         }
-        return std::make_shared<FlatShape>( lotOutline, lotHoles );
+        return makeShared<FlatShape>( lotOutline, lotHoles );
     }
 
     // * * *
 
     FlatShape( const FlatShape &s )
-        : mOutline( s.mOutline ), mHoles( s.mHoles ), mMesh( s.mMesh ), mArea( s.mArea )
+        : mOutline( s.mOutline ), mHoles( s.mHoles ), mMesh( s.mMesh ), mArea( s.mArea ), mBounds( s.mBounds ), mCache( s.mCache )
     {}
     FlatShape( const ci::PolyLine2f &outline, const PolyLine2fs &holes = {} )
         : mOutline( outline ), mHoles( holes )
@@ -73,39 +77,49 @@ class FlatShape {
         mArea = calcArea();
     };
 
-    const ci::PolyLine2f    outline() const { return mOutline; }
-    const PolyLine2fs       holes() const { return mHoles; }
+    // These are views into the shape, copy them if you need them to outlive
+    // it.
+    const ci::PolyLine2f&   outline() const { return mOutline; }
+    const PolyLine2fs&      holes() const { return mHoles; }
 
-    std::vector<seg2>       edges() const;
+    // Outline then holes. Worked out the first time it's asked for.
+    const std::vector<seg2>& edges() const;
 
     const ci::TriMeshRef    mesh() const;
 
     float       area() const { return mArea; }
     ci::vec2    centroid() const;
-    ci::Rectf   boundingBox() const { return ci::Rectf( mOutline.getPoints() ); }
-    ci::vec2    randomPoint() const;
+    ci::Rectf   boundingBox() const { return mBounds; }
+    ci::vec2    randomPoint( ci::Rand &rand ) const;
 
     bool        contains( const ci::vec2 point ) const;
 
+    // Stable across runs and platforms so it can be used to identify a shape
+    // when seeding random numbers.
+    uint32_t    hash() const;
+
+    // Exactly the same points, in the same order.
+    bool operator==( const FlatShape &other ) const;
+
+    // Results are remembered for each amount so contracting the same shape
+    // again is cheap.
     std::vector<FlatShape>  contract( float amount ) const;
 
-    template<class K>
-    const CGAL::Polygon_2<K> polygon() const
-    {
-        return polygonFrom<K>( mOutline );
-    }
+    // Interior straight skeleton, built the first time it's asked for and
+    // shared after that so don't modify it. Null if CGAL couldn't build one.
+    SsPtr                   skeleton() const;
 
+    // Converted the first time each kernel is asked for and kept. Only
+    // ExactK and InexactK are available.
     template<class K>
-    const CGAL::Polygon_with_holes_2<K> polygonWithHoles() const
-    {
-        CGAL::Polygon_with_holes_2<K> poly( polygonFrom<K>( mOutline ) );
-        for ( const auto &h : mHoles ) {
-            poly.add_hole( polygonFrom<K>( h ) );
-        }
-        return poly;
-    }
+    const CGAL::Polygon_2<K>&               polygon() const;
+    template<class K>
+    const CGAL::Polygon_with_holes_2<K>&    polygonWithHoles() const;
 
-    Arrangement_2 arrangement() const;
+    // Built the first time it's asked for and kept for the life of the shape.
+    // Copy it if you want to change anything, copying is much cheaper than
+    // building it.
+    const Arrangement_2&    arrangement() const;
 
     // Create a set of parallel lines that cross the shape, returns only the
     // segments that overlap the shape.
@@ -155,8 +169,19 @@ class FlatShape {
     void    fixUp();
     float   calcArea() const;
 
+    // Things worked out from the geometry on demand. Copies share it since
+    // the geometry never changes once the shape is built.
+    struct Cache;
+
     ci::PolyLine2f          mOutline;
     PolyLine2fs             mHoles;
     float                   mArea;
+    ci::Rectf               mBounds;
     mutable ci::TriMeshRef  mMesh;
+    std::shared_ptr<Cache>  mCache;
 };
+
+template<> const CGAL::Polygon_2<ExactK>&               FlatShape::polygon<ExactK>() const;
+template<> const CGAL::Polygon_2<InexactK>&             FlatShape::polygon<InexactK>() const;
+template<> const CGAL::Polygon_with_holes_2<ExactK>&    FlatShape::polygonWithHoles<ExactK>() const;
+template<> const CGAL::Polygon_with_holes_2<InexactK>&  FlatShape::polygonWithHoles<InexactK>() const;
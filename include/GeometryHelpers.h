@@ -78,6 +78,17 @@ seg2 oobDivider( const ci::PolyLine2f &outline, float fraction = 0.5 );
 seg2 oobDivider( const ci::Rectf &bounds, float angle, float fraction = 0.5 );
 
 
+// Move a closed outline into a standard pose so that translated or rotated
+// copies of it come out the same: centroid at the origin, longest edge along
+// the x-axis and starting from that edge. Copies still differ by floating
+// point noise from the rotation so compare them with outlinesMatch(). To put
+// it back, rotate by rotation then translate to origin.
+ci::PolyLine2f canonicalOutline( const ci::PolyLine2f &outline, ci::vec2 &origin, float &rotation );
+
+// True if a and b have the same number of points and each is within tolerance
+// of its counterpart.
+bool outlinesMatch( const std::vector<ci::vec2> &a, const std::vector<ci::vec2> &b, float tolerance = 0.01 );
+
 // Gives back pairs of points to divide the shape with lines of a given angle.
 std::vector<seg2> computeDividers( const std::vector<ci::vec2> &outline,
     const float angle = 0, const float width = 100 );
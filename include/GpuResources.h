@@ -0,0 +1,87 @@
+//
+//  GpuResources.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "CityData.h"
+
+#include "cinder/gl/gl.h"
+
+#include <map>
+
+// Holds on to the GL objects that don't change from one layout to the next:
+// the compiled shaders, the sky and the vertex buffers for each piece of
+// scenery. Rebuilding a CityView then only has to upload its instance data.
+// GL isn't thread safe so only use it from the thread with the context.
+class GpuResources {
+  public:
+    // The one shared across the process.
+    static GpuResources& shared();
+
+    ci::gl::GlslProgRef colorShader();
+    // The instanced shaders come in two flavors, for CityView's packed
+    // instances and for full matrices.
+    ci::gl::GlslProgRef buildingShader( bool fullMatrices );
+    ci::gl::GlslProgRef treeShader( bool fullMatrices );
+    ci::gl::BatchRef sky();
+
+    // A new mesh sharing the vertex and index buffers uploaded for one of
+    // scenery's levels of detail. It's the caller's to append instance
+    // buffers to. Scenery is matched by identity so it's only uploaded the
+    // first time it's seen.
+    ci::gl::VboMeshRef mesh( const SceneryRef &scenery, size_t level );
+
+    // Every level of every scenery asked for, positions only, packed end to
+    // end in one vertex and one index buffer so they can all go out in a
+    // single draw call.
+    struct PackedMesh {
+        GLuint  firstIndex = 0;
+        GLuint  indexCount = 0;
+        GLint   baseVertex = 0;
+    };
+    PackedMesh packedMesh( const SceneryRef &scenery, size_t level );
+    // These are replaced as they grow so fetch them after packing.
+    ci::gl::VboRef packedPositions() const { return mPackedPositionVbo; }
+    ci::gl::VboRef packedIndices() const { return mPackedIndexVbo; }
+
+    // Drops the buffers of any scenery that's no longer around. The packed
+    // buffers are only rebuilt once half of them is dead.
+    void purge();
+    // True if there are still buffers for scenery, it can be expired.
+    bool holds( const std::weak_ptr<const Scenery> &scenery ) const;
+    // Drops everything. Call before the GL context goes away.
+    void clear();
+
+  private:
+    struct Uploaded {
+        // Held weakly so the cache doesn't keep plans alive. It also tells a
+        // different scenery that landed at the same address from the old one.
+        std::weak_ptr<const Scenery>        scenery;
+        std::vector<ci::gl::VboMeshRef>     levels;
+        std::vector<PackedMesh>             packed;
+    };
+
+    // The entry for scenery, emptied out if it was left by something else.
+    Uploaded& uploadedFor( const SceneryRef &scenery );
+    void forget( const Uploaded &uploaded );
+    // Sends whatever's been packed since last time.
+    void uploadPacked();
+
+    // Indexed by fullMatrices.
+    ci::gl::GlslProgRef mBuildingShaders[2];
+    ci::gl::GlslProgRef mTreeShaders[2];
+    ci::gl::BatchRef    mSky;
+    std::map<const Scenery*, Uploaded> mMeshes;
+
+    std::vector<ci::vec3>   mPackedPositions;
+    std::vector<uint32_t>   mPackedIndices;
+    // Indices of scenery that's gone.
+    size_t                  mDeadIndices = 0;
+    size_t                  mUploadedPositions = 0;
+    size_t                  mUploadedIndices = 0;
+    ci::gl::VboRef          mPackedPositionVbo;
+    ci::gl::VboRef          mPackedIndexVbo;
+};
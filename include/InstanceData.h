@@ -0,0 +1,44 @@
+//
+//  InstanceData.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "cinder/Color.h"
+#include "cinder/Matrix.h"
+#include "cinder/Vector.h"
+
+#include <boost/optional.hpp>
+
+// What CityView sends the shaders for each instance of a piece of scenery.
+// Nearly everything is only moved, turned about z and scaled along its axes,
+// so that's all it holds, 24 bytes rather than 80.
+struct InstanceData {
+    // Nothing if transform is more than a move, a turn and a scale, or a
+    // scale won't fit in a half float.
+    static boost::optional<InstanceData> pack( const ci::mat4 &transform, const ci::ColorA &color );
+
+    ci::mat4 matrix() const;
+    ci::vec4 rgba() const;
+
+    ci::vec3    position;
+    // Half floats. The first two are the x axis, which carries both the turn
+    // and how much x is scaled, then how much y and z are scaled. y is
+    // negative when it's mirrored.
+    uint16_t    axes[4];
+    // 8 bits a channel, red in the low byte.
+    uint32_t    color;
+};
+
+// For transforms InstanceData can't hold.
+struct FullInstanceData {
+    FullInstanceData( const ci::mat4 &mv, const ci::vec4 &c )
+        : modelView( mv ), color( c ) {};
+    FullInstanceData( const InstanceData &compact )
+        : modelView( compact.matrix() ), color( compact.rgba() ) {};
+
+    ci::mat4 modelView;
+    ci::vec4 color;
+};
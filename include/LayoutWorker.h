@@ -0,0 +1,66 @@
+//
+//  LayoutWorker.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "CityData.h"
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+namespace Cityscape {
+
+// Runs the pipeline on its own thread so edits don't stall the UI. Each
+// request works from a snapshot of the model's inputs, so the UI is free to
+// keep changing highways and zoning plans while it runs. A newer request
+// cancels the one in flight at the next stage boundary.
+class LayoutWorker {
+  public:
+    LayoutWorker();
+    ~LayoutWorker();
+
+    LayoutWorker( const LayoutWorker& ) = delete;
+    LayoutWorker& operator=( const LayoutWorker& ) = delete;
+
+    // Copies the inputs (highways, zoning plans and settings) out of model and
+    // queues them to be laid out. Only the parts of the last finished layout
+    // whose inputs changed are rebuilt.
+    // Call from a single thread.
+    void request( const CityModel &model );
+
+    // If a layout finished since the last call, copy its pavement, streets and
+    // districts into model and return true. The inputs in model are left
+    // alone since they may have been edited in the meantime.
+    bool takeResult( CityModel &model );
+
+    // True while there's a request that hasn't been picked up with
+    // takeResult().
+    bool isBusy();
+
+  private:
+    void loop();
+
+    std::mutex              mMutex;
+    std::condition_variable mWake;
+    std::thread             mThread;
+
+    uint64_t                mGeneration = 0;
+    bool                    mHasRequest = false;
+    bool                    mWorking = false;
+    CityModel               mRequest;
+    bool                    mHasResult = false;
+    CityModel               mResult;
+    bool                    mStopping = false;
+
+    // Only touched by the thread calling request().
+    std::map<ZoningPlanRef, ZoningPlanRef>  mPlanCopies;
+    // Only touched by the worker.
+    CityModel                               mPrevious;
+};
+
+}
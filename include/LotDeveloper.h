@@ -11,18 +11,22 @@
 #include "CityData.h"
 #include "BuildingPlan.h"
 
+#include "cinder/Rand.h"
+
 namespace Cityscape {
 
+// Developers only draw random numbers from the rand they're handed so a lot
+// comes out the same no matter which thread builds it or when.
 class LotDeveloper {
   public:
     virtual ~LotDeveloper() {};
     virtual bool isValidFor( LotRef &lot ) const { return true; }
-    virtual void buildIn( LotRef &lot ) const {};
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const {};
 };
 
 class ParkDeveloper : public LotDeveloper {
   public:
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
   private:
     float mTreeCoverRatio;
@@ -34,7 +38,7 @@ class SingleFamilyHomeDeveloper : public LotDeveloper {
         : mPlans( plans ) {};
 
     virtual bool isValidFor( LotRef &lot ) const override;
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
   private:
     std::vector<SceneryRef> mPlans;
@@ -46,7 +50,7 @@ class PickFromListDeveloper : public LotDeveloper {
         : mPlans( plans ) {};
 
     virtual bool isValidFor( LotRef &lot ) const override;
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
   private:
     std::vector<SceneryRef> mPlans;
@@ -57,7 +61,7 @@ class FullLotDeveloper : public LotDeveloper {
     FullLotDeveloper( RoofStyle roof ): mRoof( roof ) {};
 
     virtual bool isValidFor( LotRef &lot ) const override;
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
     const RoofStyle mRoof;
 };
@@ -69,7 +73,7 @@ class SquareGridDeveloper : public LotDeveloper {
     {};
 
     virtual bool isValidFor( LotRef &lot )  const override;
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
     const float mAngle;
     const float mRowSpacing;
@@ -82,7 +86,7 @@ class FarmOrchardDeveloper : public LotDeveloper {
     FarmOrchardDeveloper( float angle = 0.0, float spacing = 13.0, float diameter = 5.0f )
         : mAngle( angle ), mTreeSpacing( spacing ), mDiameter( diameter ) {};
 
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
     const float mAngle;
     const float mTreeSpacing;
@@ -94,7 +98,7 @@ class FarmFieldDeveloper : public LotDeveloper {
     FarmFieldDeveloper( float rowSpacing = 10.0, float rowWidth = 5.0f, const SceneryRef building = nullptr )
         : mRowSpacing( rowSpacing ), mRowWidth( rowWidth ), mBuilding( building ) {};
 
-    virtual void buildIn( LotRef &lot ) const override;
+    virtual void buildIn( LotRef &lot, ci::Rand &rand ) const override;
 
     const float mRowSpacing;
     const float mRowWidth;
@@ -0,0 +1,26 @@
+//
+//  ParallelFor.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace Cityscape {
+    // How many threads parallelFor spreads work across, including the calling
+    // thread. Defaults to the number of cores. Set it to 1 to run everything
+    // serially on the caller, which is handy for debugging and comparisons.
+    void    setWorkerThreadCount( size_t count );
+    size_t  workerThreadCount();
+
+    // Calls work( i ) for every i in [0, count) using a shared pool of worker
+    // threads and returns once they've all finished. The order the calls happen
+    // in is unspecified so work should only touch state belonging to its own
+    // index. If any call throws the remaining indices are skipped and the
+    // first exception is rethrown on the caller. Nested calls from inside work
+    // run serially.
+    void parallelFor( size_t count, const std::function<void(size_t)> &work );
+}
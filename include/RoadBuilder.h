@@ -11,11 +11,19 @@
 #include "CityData.h"
 
 namespace Cityscape {
+    // in PolyLines
+    // out Highways (one per segment)
+    void setHighways( CityModel &city, const std::vector<ci::PolyLine2f> &lines );
+
     // in Highways
     // out Districts and paved FlatShape
+    //
+    // Skipped when the highways haven't changed since the last run. Districts
+    // from the previous run that come out with the same shape keep whatever
+    // blocks, lots and scenery are still good under their new zoning plan.
     void buildHighwaysAndDistricts( CityModel &city );
 
     // in Districts
-    // out Streets, Blocks and paved FlatShape
+    // out Streets, Blocks and paved FlatShape (on the district)
     void buildStreetsAndBlocks( CityModel &city );
 }
@@ -0,0 +1,43 @@
+//
+//  Scenario.h
+//  Cityscape
+//
+//
+
+#pragma once
+
+#include "CityData.h"
+
+namespace Cityscape {
+    // Everything needed to lay out a city without the UI: the highways and the
+    // zoning plans that get handed out to the districts between them.
+    struct Scenario {
+        uint32_t                    seed = 1;
+        uint8_t                     highwayWidth = 20;
+        std::vector<ci::PolyLine2f> highways;
+        std::vector<ZoningPlanRef>  zoningPlans;
+    };
+
+    // Reads a plain text scenario, one setting per line:
+    //
+    //   # Comments start with a hash
+    //   seed 1
+    //   highway-width 20
+    //   zoning farming majestic-heights downtown
+    //   highway -154,-213 -144,197 208,170 83,0
+    //
+    // Each highway line is a polyline of x,y points. Without a zoning line the
+    // plans CityMode starts with are used. Returns false and describes the
+    // problem in error if the input can't be understood.
+    bool loadScenario( std::istream &input, Scenario &scenario, std::string &error );
+
+    // A model with the scenario's inputs filled in, ready for the pipeline.
+    CityModel modelFrom( const Scenario &scenario );
+
+    // The highways behind CityMode's "Test 1" through "Test 5" buttons. Returns
+    // an empty set for any other number.
+    std::vector<ci::PolyLine2f> sampleHighways( int which );
+
+    // A repeatable tangle of straight highways, one per segment, inside bounds.
+    std::vector<ci::PolyLine2f> randomHighways( size_t segments, const ci::Rectf &bounds, uint32_t seed );
+}
@@ -19,7 +19,9 @@ class ConeTree : public Scenery {
     ConeTree( u_int8_t subdivisions = 12 )
     :   Scenery(
             polyLineCircle( 0.5, subdivisions ),
-            ci::geom::Cone().radius( 0.5, 0.0 ).height( 1 ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( subdivisions ).subdivisionsHeight( 2 )
+            roundLevels( subdivisions, []( u_int8_t s ) -> ci::geom::SourceMods {
+                return ci::geom::Cone().radius( 0.5, 0.0 ).height( 1 ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( s ).subdivisionsHeight( 2 );
+            } )
         )
     {}
 
@@ -48,7 +50,9 @@ class SphereTree : public Scenery {
     SphereTree( u_int8_t subdivisions = 12 )
     :   Scenery(
             polyLineCircle( 0.5, subdivisions ),
-            ci::geom::Sphere().radius( 0.5 ).subdivisions( subdivisions )
+            roundLevels( subdivisions, []( u_int8_t s ) -> ci::geom::SourceMods {
+                return ci::geom::Sphere().radius( 0.5 ).subdivisions( s );
+            } )
         )
     {}
 
@@ -113,10 +117,11 @@ class GrainSiloConeTop : public Scenery {
     GrainSiloConeTop( float radius, float height, float overhang, u_int8_t subdivisions = 12 )
     :   Scenery(
             polyLineCircle( radius, subdivisions ),
-            ci::geom::SourceMods()
-                & ci::geom::Cone().base( radius + overhang ).height( radius / 2.0 ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( subdivisions ) >> ci::geom::Translate( ci::vec3( 0, 0, height ) )
-                & ci::geom::Cylinder().radius( radius ).height( height ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( subdivisions )
-
+            roundLevels( subdivisions, [=]( u_int8_t s ) -> ci::geom::SourceMods {
+                return ci::geom::SourceMods()
+                    & ci::geom::Cone().base( radius + overhang ).height( radius / 2.0 ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( s ) >> ci::geom::Translate( ci::vec3( 0, 0, height ) )
+                    & ci::geom::Cylinder().radius( radius ).height( height ).direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( s );
+            } )
         )
     {}
 
@@ -133,9 +138,11 @@ class SmokeStack : public Scenery {
     SmokeStack( float radius, float height, u_int8_t subdivisions = 12 )
     :   Scenery(
             polyLineCircle( radius * 0.5, subdivisions ),
-            ci::geom::Cone().base( radius * 0.5 ).apex( radius * 0.4 ).height( height )
-                .direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( subdivisions )
-                .subdivisionsHeight( 2 )
+            roundLevels( subdivisions, [=]( u_int8_t s ) -> ci::geom::SourceMods {
+                return ci::geom::Cone().base( radius * 0.5 ).apex( radius * 0.4 ).height( height )
+                    .direction( ci::vec3( 0, 0, 1 ) ).subdivisionsAxis( s )
+                    .subdivisionsHeight( 2 );
+            } )
         )
     {}
 
@@ -150,8 +157,10 @@ class OilTank : public Scenery {
     OilTank( float radius, float height, u_int8_t subdivisions = 12 )
     :   Scenery(
             polyLineCircle( radius * 0.5, subdivisions ),
-            ci::geom::Cylinder().radius( radius * 0.5 ).height( height )
-                .subdivisionsAxis( subdivisions ).direction( ci::vec3( 0, 0, 1 ) )
+            roundLevels( subdivisions, [=]( u_int8_t s ) -> ci::geom::SourceMods {
+                return ci::geom::Cylinder().radius( radius * 0.5 ).height( height )
+                    .subdivisionsAxis( s ).direction( ci::vec3( 0, 0, 1 ) );
+            } )
         )
     {}
 
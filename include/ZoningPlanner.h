@@ -18,4 +18,8 @@ ZoningPlanRef zoneFarming();
 ZoningPlanRef zoneIndustrial();
 ZoningPlanRef zoneDowntown();
 
+// Look up one of the plans above by name (farming, majestic-heights,
+// industrial, downtown). Returns nullptr for anything else.
+ZoningPlanRef zoneNamed( const std::string &name );
+
 } // namespace Cityscape
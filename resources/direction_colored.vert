@@ -4,13 +4,34 @@ uniform mat4    ciModelView;
 uniform mat4    ciModelViewProjection;
 
 in vec4         ciPosition;
+#ifdef FULL_MATRICES
 in mat4         vInstanceModelMatrix; // per-instance position variable
 in vec4         vInstanceColor; // ignored
+#else
+in vec3         vInstancePosition; // per-instance position
+in vec4         vInstanceAxes; // x axis, then y and z scale, as half floats
+in int          vInstanceColor; // ignored
+#endif
 out vec3        eyespacePosition;
 
+mat4 instanceMatrix()
+{
+#ifdef FULL_MATRICES
+    return vInstanceModelMatrix;
+#else
+    vec2 across = vInstanceAxes.xy;
+    vec2 along = vec2( -across.y, across.x ) * ( vInstanceAxes.z / length( across ) );
+    return mat4(
+        vec4( across, 0, 0 ),
+        vec4( along, 0, 0 ),
+        vec4( 0, 0, vInstanceAxes.w, 0 ),
+        vec4( vInstancePosition, 1 ) );
+#endif
+}
+
 void main()
 {
     eyespacePosition = (ciModelView * ciPosition).xyz;
 
-    gl_Position = ciModelViewProjection * vInstanceModelMatrix * ciPosition;
+    gl_Position = ciModelViewProjection * instanceMatrix() * ciPosition;
 }
@@ -3,13 +3,43 @@
 uniform mat4 ciModelViewProjection;
 
 in vec4 ciPosition;
+#ifdef FULL_MATRICES
 in mat4 vInstanceModelMatrix; // per-instance position variable
 in vec4 vInstanceColor;
+#else
+in vec3 vInstancePosition; // per-instance position
+in vec4 vInstanceAxes; // x axis, then y and z scale, as half floats
+in int  vInstanceColor; // RGBA8, red in the low byte
+#endif
 
 out vec4 Color;
 
+mat4 instanceMatrix()
+{
+#ifdef FULL_MATRICES
+    return vInstanceModelMatrix;
+#else
+    vec2 across = vInstanceAxes.xy;
+    vec2 along = vec2( -across.y, across.x ) * ( vInstanceAxes.z / length( across ) );
+    return mat4(
+        vec4( across, 0, 0 ),
+        vec4( along, 0, 0 ),
+        vec4( 0, 0, vInstanceAxes.w, 0 ),
+        vec4( vInstancePosition, 1 ) );
+#endif
+}
+
+vec4 instanceColor()
+{
+#ifdef FULL_MATRICES
+    return vInstanceColor;
+#else
+    return vec4( vInstanceColor & 0xFF, ( vInstanceColor >> 8 ) & 0xFF, ( vInstanceColor >> 16 ) & 0xFF, ( vInstanceColor >> 24 ) & 0xFF ) / 255.0;
+#endif
+}
+
 void main( void )
 {
-    gl_Position = ciModelViewProjection * vInstanceModelMatrix * ciPosition;
-    Color       = vInstanceColor;
-}
\ No newline at end of file
+    gl_Position = ciModelViewProjection * instanceMatrix() * ciPosition;
+    Color       = instanceColor();
+}
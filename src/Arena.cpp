@@ -0,0 +1,59 @@
+//
+//  Arena.cpp
+//  Cityscape
+//
+//
+
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace {
+    thread_local Arena::Scope *tScope = nullptr;
+}
+
+Arena::~Arena()
+{
+    for ( char *chunk : mChunks ) {
+        delete[] chunk;
+    }
+}
+
+void* Arena::allocate( size_t size, size_t alignment )
+{
+    uintptr_t next = reinterpret_cast<uintptr_t>( mNext );
+    uintptr_t aligned = ( next + alignment - 1 ) & ~uintptr_t( alignment - 1 );
+
+    if ( !mNext || aligned + size > reinterpret_cast<uintptr_t>( mEnd ) ) {
+        // Anything too big to share a chunk gets one to itself. new[] hands
+        // back memory aligned for any fundamental type.
+        size_t chunkSize = std::max( mChunkSize, size );
+        char *chunk = new char[chunkSize];
+        mChunks.push_back( chunk );
+        mChunkSize = std::min( mChunkSize * 2, mMaxChunkSize );
+        mNext = chunk;
+        mEnd = chunk + chunkSize;
+        aligned = reinterpret_cast<uintptr_t>( chunk );
+    }
+
+    mNext = reinterpret_cast<char*>( aligned + size );
+    mBytesAllocated += size;
+    return reinterpret_cast<void*>( aligned );
+}
+
+std::shared_ptr<Arena> Arena::current()
+{
+    return tScope ? tScope->mArena : nullptr;
+}
+
+Arena::Scope::Scope( const std::shared_ptr<Arena> &arena )
+    : mArena( arena ), mPrevious( tScope )
+{
+    tScope = this;
+}
+
+Arena::Scope::~Scope()
+{
+    tScope = mPrevious;
+}
@@ -12,6 +12,7 @@
 #include "CgalArrangement.h"
 #include "CgalStraightSkeleton.h"
 #include "GeometryHelpers.h"
+#include "ParallelFor.h"
 
 #include "cinder/Rand.h"
 
@@ -93,7 +94,7 @@ void noopSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block )
 // Procedural Generation of Parcels in Urban Modeling
 // Carlos A. Vanegas, Tom Kelly, Basil Weber, Jan Halatsch, Daniel G. Aliaga, Pascal Müller
 // http://www.twak.co.uk/2011/12/procedural-generation-of-parcels-in.html
-void oobSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block )
+void oobSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block, ci::Rand &rand )
 {
     std::queue<LotRef> toSplit;
 
@@ -120,7 +121,7 @@ void oobSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block )
         bool tooSmall = true;
         std::vector<LotRef> splitLots;
         do {
-            float fraction = randFloat( 0.45, 0.5 );
+            float fraction = rand.nextFloat( 0.45, 0.5 );
 
             // TODO: Move to a function
             Segment_2 divider = segmentFrom( oobDivider( oob.second, oob.first, fraction ) );
@@ -154,8 +155,9 @@ void skeletonSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block
     // For closed outlines, we need at least 4 points.
     if ( block->shape->outline().size() < 4 ) return;
 
-    // Build straight skeleton with holes
-    SsPtr skel = CGAL::create_interior_straight_skeleton_2( block->shape->polygonWithHoles<InexactK>() );
+    // Straight skeleton with holes
+    SsPtr skel = block->shape->skeleton();
+    if ( !skel ) return;
 
     // Find the segments that make up the skeleton (ignoring edges connecting
     // to the outline).
@@ -243,30 +245,57 @@ void skeletonSubdivide( const ZoningPlan::BlockOptions &options, BlockRef &block
     block->lots = slice( arrBlock, arrDividers );
 }
 
+void subdivideBlock( const ZoningPlanRef &zoning, BlockRef &block, uint32_t citySeed )
+{
+    ZoningPlan::LotDivision d = zoning->block.lotDivision;
+
+    // Don't bother dividing small blocks
+    if ( block->shape->area() < zoning->block.lotAreaMin ) {
+        d = ZoningPlan::LotDivision::NO_LOT_DIVISION;
+    }
+
+    if ( d == ZoningPlan::LotDivision::OOB_LOT_DIVISION ) {
+        // Each block gets its own stream so it divides the same way no matter
+        // which thread picks it up or when.
+        ci::Rand rand( seedFor( citySeed, block->shape->hash() ) );
+        oobSubdivide( zoning->block, block, rand );
+    }
+    else if ( d == ZoningPlan::LotDivision::SKELETON_LOT_DIVISION ) {
+        skeletonSubdivide( zoning->block, block );
+    }
+    else {
+        noopSubdivide( zoning->block, block );
+    }
+}
+
 // in Blocks
 // out Lots
 void subdivideBlocks( CityModel &city )
 {
+    // Only the blocks that haven't been divided up with the current settings.
+    std::vector<std::pair<ZoningPlanRef, BlockRef>> blocks;
     for ( auto &district : city.districts ) {
-        ZoningPlanRef zoning = district->zoningPlan;
-
+        const uint64_t key = lotsKeyFor( *district->zoningPlan, city.seed );
         for ( auto &block : district->blocks ) {
-            ZoningPlan::LotDivision d = zoning->block.lotDivision;
-
-            // Don't bother dividing small blocks
-            if ( block->shape->area() < zoning->block.lotAreaMin ) {
-                d = ZoningPlan::LotDivision::NO_LOT_DIVISION;
-            }
+            if ( block->lotsKey != key ) blocks.push_back( { district->zoningPlan, block } );
+        }
+    }
 
-            if ( d == ZoningPlan::LotDivision::OOB_LOT_DIVISION ) {
-                oobSubdivide( zoning->block, block );
-            }
-            else if ( d == ZoningPlan::LotDivision::SKELETON_LOT_DIVISION ) {
-                skeletonSubdivide( zoning->block, block );
-            }
-            else {
-                noopSubdivide( zoning->block, block );
-            }
+    parallelFor( blocks.size(), [&]( size_t i ) {
+        BlockRef &block = blocks[i].second;
+        block->lots.clear();
+        // Keep the block's lots and their shapes side by side in memory, they
+        // all get replaced together next time anyway.
+        Arena::Scope scope( Arena::create() );
+        subdivideBlock( blocks[i].first, block, city.seed );
+        block->lotsKey = lotsKeyFor( *blocks[i].first, city.seed );
+    } );
+
+    // Lots grabbed colors in whatever order the threads got to them, pick
+    // them again based on their shape so they don't change between runs.
+    for ( auto &pair : blocks ) {
+        for ( auto &lot : pair.second->lots ) {
+            lot->color = colorWheel( lot->shape->hash() );
         }
     }
 }
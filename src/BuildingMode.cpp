@@ -80,7 +80,7 @@ void BuildingMode::layout() {
     lot->buildings.clear();
 
     auto plan = BuildingPlan::create( mOutline, mBuildingSettings );
-    lot->buildings.push_back( plan->instance( ci::vec2( 0 ) ) );
+    lot->buildings.add( plan->instance( ci::vec2( 0 ) ) );
 
     mCityView = CityView::create( mModel );
 }
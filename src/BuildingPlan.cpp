@@ -13,6 +13,7 @@
 #include "GeometryHelpers.h"
 #include "FlatShape.h"
 
+#include "cinder/ConvexHull.h"
 #include "cinder/Rand.h"
 #include "cinder/Triangulate.h"
 
@@ -406,10 +407,11 @@ TriMesh buildingWithSawtoothRoof( const PolyLine2f &wallOutline, const SawtoothS
 	return result;
 }
 
+const float FLOOR_HEIGHT = 5.0;
+
 ci::geom::SourceMods buildingGeometry( const ci::PolyLine2f &outline, const BuildingSettings &settings )
 {
     ci::geom::SourceMods geometry;
-    const float FLOOR_HEIGHT = 5.0;
     float maxWallHeight = FLOOR_HEIGHT * settings.floors;
     float minWallHeight = 0;
 
@@ -446,6 +448,29 @@ ci::geom::SourceMods buildingGeometry( const ci::PolyLine2f &outline, const Buil
     return geometry;
 }
 
+ci::geom::SourceMods buildingProxyGeometry( const ci::PolyLine2f &outline, const BuildingSettings &settings )
+{
+    ci::geom::SourceMods geometry;
+    if ( outline.size() < 3 ) {
+        return geometry;
+    }
+
+    // Hulls come back counterclockwise but that's not something to count on.
+    PolyLine2f hull = calcConvexHull( outline.getPoints() );
+    if ( hull.size() < 3 ) {
+        return geometry;
+    }
+    if ( hull.isClockwise() ) {
+        hull.reverse();
+    }
+    if ( hull.getPoints().front() != hull.getPoints().back() ) {
+        hull.push_back( hull.getPoints().front() );
+    }
+
+    geometry = buildingWithFlatRoof( hull, FLOOR_HEIGHT * settings.floors, 0, 0 );
+    return geometry;
+}
+
 // Builds a wedding cake style building from a footprint and list of heights and contractions for the next layer
 ci::geom::SourceMods weddingCake( const ci::PolyLine2f &footprint, const std::vector<std::pair<float, float>> &heightAndContraction )
 {
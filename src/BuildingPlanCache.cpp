@@ -0,0 +1,153 @@
+//
+//  BuildingPlanCache.cpp
+//  Cityscape
+//
+//
+
+#include "BuildingPlanCache.h"
+#include "GeometryHelpers.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+using namespace ci;
+
+// How far apart matching outlines' points can be.
+const float OUTLINE_TOLERANCE = 0.01f;
+// Outlines are hashed by their perimeter rounded down to this so ones that are
+// off by a little usually land together. Those that straddle a boundary are
+// caught by looking on both sides.
+const float PERIMETER_BUCKET = 1.0f;
+
+int32_t perimeterBucket( float perimeter )
+{
+    return int32_t( std::floor( perimeter / PERIMETER_BUCKET ) );
+}
+
+// FNV-1a over the outline's size, perimeter bucket and settings. Negative zero
+// is folded into zero so it doesn't split otherwise identical settings.
+uint32_t planHash( size_t pointCount, int32_t bucket, const BuildingSettings &settings )
+{
+    uint32_t hash = 2166136261u;
+    auto add = [&hash]( const void *data, size_t size ) {
+        const unsigned char *bytes = static_cast<const unsigned char*>( data );
+        for ( size_t i = 0; i < size; ++i ) {
+            hash ^= bytes[i];
+            hash *= 16777619u;
+        }
+    };
+    auto addFloat = [&add]( float f ) {
+        if ( f == 0 ) f = 0;
+        add( &f, sizeof( f ) );
+    };
+
+    add( &pointCount, sizeof( pointCount ) );
+    add( &bucket, sizeof( bucket ) );
+    add( &settings.floors, sizeof( settings.floors ) );
+    add( &settings.roofStyle, sizeof( settings.roofStyle ) );
+    addFloat( settings.slope );
+    addFloat( settings.overhang );
+    return hash;
+}
+
+BuildingPlanCache& BuildingPlanCache::shared()
+{
+    static BuildingPlanCache cache;
+    return cache;
+}
+
+SceneryRef BuildingPlanCache::plan( const PolyLine2f &outline, const BuildingSettings &settings )
+{
+    const std::vector<vec2> &points = outline.getPoints();
+    float perimeter = 0;
+    for ( size_t i = 1; i < points.size(); ++i ) {
+        perimeter += glm::distance( points[i - 1], points[i] );
+    }
+    // Each point being off by up to the tolerance can move the perimeter by
+    // twice that.
+    const float slack = 2 * OUTLINE_TOLERANCE * points.size();
+    const uint32_t hash = planHash( points.size(), perimeterBucket( perimeter ), settings );
+    std::vector<uint32_t> hashes = { hash };
+    for ( float nearby : { perimeter - slack, perimeter + slack } ) {
+        uint32_t other = planHash( points.size(), perimeterBucket( nearby ), settings );
+        if ( std::find( hashes.begin(), hashes.end(), other ) == hashes.end() ) hashes.push_back( other );
+    }
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        if ( SceneryRef found = find( hashes, points, settings ) ) {
+            ++mStats.hits;
+            return found;
+        }
+        ++mStats.misses;
+    }
+
+    // Build it without holding the lock, this is the slow part.
+    SceneryRef built = BuildingPlan::create( outline, settings );
+
+    std::lock_guard<std::mutex> lock( mMutex );
+    // Someone else might have beaten us to it.
+    if ( SceneryRef found = find( hashes, points, settings ) ) {
+        return found;
+    }
+    mEntries.push_front( { hash, points, settings, built } );
+    mIndex.insert( { hash, mEntries.begin() } );
+    trim();
+    return built;
+}
+
+BuildingPlanCache::Stats BuildingPlanCache::stats()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    Stats result = mStats;
+    result.size = mEntries.size();
+    return result;
+}
+
+void BuildingPlanCache::setCapacity( size_t capacity )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    mCapacity = capacity;
+    trim();
+}
+
+void BuildingPlanCache::clear()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    mEntries.clear();
+    mIndex.clear();
+    mStats = Stats();
+}
+
+SceneryRef BuildingPlanCache::find( const std::vector<uint32_t> &hashes, const std::vector<vec2> &points, const BuildingSettings &settings )
+{
+    for ( uint32_t hash : hashes ) {
+        auto range = mIndex.equal_range( hash );
+        for ( auto it = range.first; it != range.second; ++it ) {
+            EntryList::iterator entry = it->second;
+            if ( entry->settings == settings && outlinesMatch( entry->points, points, OUTLINE_TOLERANCE ) ) {
+                // Bump it to the front.
+                mEntries.splice( mEntries.begin(), mEntries, entry );
+                return entry->plan;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void BuildingPlanCache::trim()
+{
+    while ( mEntries.size() > mCapacity ) {
+        EntryList::iterator oldest = std::prev( mEntries.end() );
+        auto range = mIndex.equal_range( oldest->hash );
+        for ( auto it = range.first; it != range.second; ++it ) {
+            if ( it->second == oldest ) {
+                mIndex.erase( it );
+                break;
+            }
+        }
+        mEntries.erase( oldest );
+        ++mStats.evictions;
+    }
+}
@@ -14,6 +14,9 @@
 #include "BuildingPlan.h"
 #include "LotDeveloper.h"
 
+#include <algorithm>
+#include <atomic>
+
 using namespace ci;
 
 namespace Cityscape {
@@ -21,17 +24,101 @@ namespace Cityscape {
 // Give relatively unique colors
 ColorA colorWheel()
 {
-    static float hue = 0.0f;
-    ColorA color = ci::ColorA( ci::CM_HSV, hue, 1.0, 1.0, 0.5 );
-    hue += 0.17f;
-    if (hue > 1) hue -= 1.0f;
-    return color;
+    static std::atomic<size_t> next( 0 );
+    return colorWheel( next++ );
+}
+
+ColorA colorWheel( size_t index )
+{
+    float hue = std::fmod( index * 0.17, 1.0 );
+    return ci::ColorA( ci::CM_HSV, hue, 1.0, 1.0, 0.5 );
+}
+
+uint32_t seedFor( uint32_t citySeed, uint32_t id )
+{
+    // MurmurHash3's finalizer, so nearby IDs end up with unrelated seeds.
+    uint32_t h = citySeed ^ ( id + 0x9e3779b9 + ( citySeed << 6 ) + ( citySeed >> 2 ) );
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
 }
 
 
 // * * *
 
 
+// 64 bit FNV-1a, fed one field at a time.
+struct KeyHasher {
+    template<typename T>
+    KeyHasher& add( const T &value )
+    {
+        const unsigned char *bytes = reinterpret_cast<const unsigned char*>( &value );
+        for ( size_t i = 0; i < sizeof( T ); ++i ) {
+            hash ^= bytes[i];
+            hash *= 1099511628211u;
+        }
+        return *this;
+    }
+
+    // Keep clear of zero, it means not built.
+    uint64_t key() const { return hash ? hash : 1; }
+
+    uint64_t hash = 14695981039346656037u;
+};
+
+uint64_t highwaysKeyFor( const CityModel &city )
+{
+    KeyHasher hasher;
+    hasher.add( city.highwayWidth );
+    for ( const auto &highway : city.highways ) {
+        for ( const vec2 &point : highway->centerline ) {
+            hasher.add( point.x ).add( point.y );
+        }
+    }
+    return hasher.key();
+}
+
+uint64_t streetsKeyFor( const ZoningPlan &plan )
+{
+    const auto &grid = plan.district.grid;
+    return KeyHasher()
+        .add( plan.district.streetDivision )
+        .add( grid.roadWidth )
+        .add( grid.avenueAngle )
+        .add( grid.streetAngle )
+        .add( grid.avenueSpacing )
+        .add( grid.streetSpacing )
+        .key();
+}
+
+uint64_t lotsKeyFor( const ZoningPlan &plan, uint32_t seed )
+{
+    return KeyHasher()
+        .add( streetsKeyFor( plan ) )
+        .add( seed )
+        .add( plan.block.lotDivision )
+        .add( plan.block.lotWidth )
+        .add( plan.block.lotAreaMin )
+        .add( plan.block.lotAreaMax )
+        .key();
+}
+
+uint64_t sceneryKeyFor( const ZoningPlan &plan, uint32_t seed )
+{
+    KeyHasher hasher;
+    hasher.add( lotsKeyFor( plan, seed ) );
+    for ( const auto &usage : plan.lotUsages ) {
+        // Developers are never changed after they're created so the pointer
+        // is enough to tell them apart.
+        hasher.add( usage.developer.get() ).add( usage.ratio );
+    }
+    return hasher.key();
+}
+
+
 CityModel::CityModel()
 {
     ZoningPlanRef nimby = ZoningPlan::create( "Not in my backyard" );
@@ -60,11 +147,26 @@ SceneryGroup::SceneryGroup( const std::vector<Item> &items )
     mFootprint = calcConvexHull( points );
 }
 
-Scenery::Instance SceneryGroup::instance( const ci::mat4 &matrix, const ci::ColorA &color ) const
+std::vector<ci::geom::SourceMods> Scenery::roundLevels( u_int8_t subdivisions, const std::function<ci::geom::SourceMods( u_int8_t )> &build )
+{
+    std::vector<ci::geom::SourceMods> levels = { build( subdivisions ) };
+    u_int8_t last = subdivisions;
+    while ( levels.size() < 3 && last > 3 ) {
+        last = std::max<int>( last / 2, 3 );
+        levels.push_back( build( last ) );
+    }
+    return levels;
+}
+
+void Scenery::addTo( InstanceTable &table, const ci::mat4 &matrix, const ci::ColorA &color ) const
+{
+    table.append( shared_from_this(), matrix, color );
+}
+
+void SceneryGroup::addTo( InstanceTable &table, const ci::mat4 &matrix, const ci::ColorA &color ) const
 {
-    Scenery::Instance instance = Scenery::Instance( shared_from_this(), matrix, color );
+    // The parts keep their own default color rather than the group's.
     for ( const Item &item : items ) {
-        instance.children.push_back( item.scenery->instance( item.transformation( matrix ) ) );
+        item.scenery->addTo( table, item.transformation( matrix ), ci::ColorA::white() );
     }
-    return instance;
 }
@@ -3,8 +3,7 @@
 #include "FlatShape.h"
 #include "ZoningPlanner.h"
 #include "RoadBuilder.h"
-#include "BlockSubdivider.h"
-#include "LotFiller.h"
+#include "Scenario.h"
 #include "GeometryHelpers.h"
 
 using namespace ci;
@@ -86,91 +85,51 @@ void CityMode::addParams( ci::params::InterfaceGlRef params)
         layout();
     }, "key=0" );
     params->addButton( "Test 1", [&] {
-        mHighways = std::vector<PolyLine2>( {
-            PolyLine2( {
-                vec2( -154, -213 ),
-                vec2( -144, 197 ),
-                vec2( 208, 170 ),
-                vec2( 83, 0 ),
-                vec2( 242, -123 ),
-            } ),
-        } );
+        mHighways = Cityscape::sampleHighways( 1 );
         layout();
     }, "key=1" );
     params->addButton( "Test 2", [&] {
-        mHighways = std::vector<PolyLine2>( {
-            PolyLine2( {
-                vec2( -154, -213 ),
-                vec2( -144, 197 ),
-                vec2( 208, 170 ),
-                vec2( 83, 0 ),
-                vec2( 242, -123 ),
-            } ),
-            PolyLine2( {
-                vec2( -156, -207 ),
-                vec2( 236, -122 ),
-            } ),
-        } );
+        mHighways = Cityscape::sampleHighways( 2 );
         layout();
     }, "key=2" );
     params->addButton( "Test 3", [&] {
         // Intentionally don't clear so we can combine with other shapes
-        mHighways.push_back( PolyLine2( {
-            vec2( -9.6225, 498.446 ),
-            vec2( -519.615,-336.788 ),
-            vec2( 533.087,-159.734 ),
-            vec2( -9.6225,498.446 ),
-        } ) );
+        auto more = Cityscape::sampleHighways( 3 );
+        mHighways.insert( mHighways.end(), more.begin(), more.end() );
         layout();
     }, "key=3" );
     params->addButton( "Test 4", [&] {
         // Intentionally don't clear so we can combine with other shapes
-        mHighways.push_back( PolyLine2( {
-            vec2( -576, 575 ),
-            vec2( 573, 572 ),
-            vec2( 573, -569 ),
-            vec2( -573, -578 ),
-            vec2( -576, 575 ),
-        } ) );
+        auto more = Cityscape::sampleHighways( 4 );
+        mHighways.insert( mHighways.end(), more.begin(), more.end() );
         layout();
     }, "key=4" );
     params->addButton( "Test 5", [&] {
-        mHighways = std::vector<PolyLine2>( {
-            PolyLine2( {
-                vec2( -206.133, 539.26 ),
-                vec2( -48.764, -527.973 ),
-                vec2( 106.45, -568.06 ),
-                vec2( 201.625, -478.988 ),
-                vec2( 124.941, -249.35 ),
-                vec2( 106.635, 485.66 ),
-                vec2( -206.857, 500.64 ),
-            } ),
-        } );
+        mHighways = Cityscape::sampleHighways( 5 );
         layout();
     }, "key=5" );
 }
 
 void CityMode::layout() {
-    mModel.highways.clear();
-    for ( auto line : mHighways ) {
-        // Translate from PolyLines into Highways... would be nice if highways
-        // weren't just simple segments :/
-        pointsInPairs<vec2>( line,
-            [&](const vec2 &a, const vec2 &b) {
-                mModel.highways.push_back( Cityscape::Highway::create( a, b ) );
-            }
-        );
-    }
+    Cityscape::setHighways( mModel, mHighways );
 
-    // TODO: Should have better way to partially update
-    // figure out how to mark progress so we can do this across a few
-    // frame updates instead of blocking
-    Cityscape::buildHighwaysAndDistricts( mModel );
-    Cityscape::buildStreetsAndBlocks( mModel );
-    Cityscape::subdivideBlocks( mModel );
-    Cityscape::fillLots( mModel );
+    // Runs in the background, update() picks up the results.
+    mLayoutWorker.request( mModel );
+}
 
-    mCityView = CityView::create( mModel );
+void CityMode::update( double elapsed )
+{
+    BaseMode::update( elapsed );
+
+    // Keep showing the old city until the new one is ready.
+    if ( mLayoutWorker.takeResult( mModel ) ) {
+        // Most of the city is usually the same as last time.
+        if ( mCityView ) {
+            mCityView->update( mModel );
+        } else {
+            mCityView = CityView::create( mModel );
+        }
+    }
 }
 
 std::vector<ci::vec2> CityMode::getPoints()
@@ -0,0 +1,65 @@
+//
+//  CityPipeline.cpp
+//  Cityscape
+//
+//
+
+#include "CityPipeline.h"
+#include "RoadBuilder.h"
+#include "BlockSubdivider.h"
+#include "LotFiller.h"
+
+#include <sys/resource.h>
+
+namespace Cityscape {
+
+const std::vector<PipelineStage>& pipelineStages()
+{
+    static const std::vector<PipelineStage> stages = {
+        PipelineStage( "buildHighwaysAndDistricts", buildHighwaysAndDistricts ),
+        PipelineStage( "buildStreetsAndBlocks", buildStreetsAndBlocks ),
+        PipelineStage( "subdivideBlocks", subdivideBlocks ),
+        PipelineStage( "fillLots", fillLots ),
+    };
+    return stages;
+}
+
+void runPipeline( CityModel &city )
+{
+    for ( const auto &stage : pipelineStages() ) {
+        stage.run( city );
+    }
+}
+
+CityStats statsFor( const CityModel &city )
+{
+    CityStats stats;
+    stats.districts = city.districts.size();
+    for ( const auto &district : city.districts ) {
+        stats.blocks += district->blocks.size();
+        for ( const auto &block : district->blocks ) {
+            stats.lots += block->lots.size();
+            for ( const auto &lot : block->lots ) {
+                stats.buildings += lot->buildings.size();
+                stats.plants += lot->plants.size();
+            }
+        }
+    }
+    return stats;
+}
+
+size_t peakMemoryUsage()
+{
+    struct rusage usage;
+    if ( getrusage( RUSAGE_SELF, &usage ) != 0 ) return 0;
+
+#if defined( __APPLE__ )
+    // Darwin reports bytes...
+    return static_cast<size_t>( usage.ru_maxrss );
+#else
+    // ...everyone else reports kilobytes.
+    return static_cast<size_t>( usage.ru_maxrss ) * 1024;
+#endif
+}
+
+} // Cityscape namespace
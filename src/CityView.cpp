@@ -9,47 +9,20 @@
 #include "CityView.h"
 #include "FlatShape.h"
 #include "BuildingPlan.h"
-#include "Resources.h"
+#include "GpuResources.h"
+#include "ParallelFor.h"
 
-using namespace ci;
-
-ci::gl::BatchRef buildSky()
-{
-    std::vector<vec3> positions;
-    std::vector<Color> colors;
-    Color darkBlue = Color8u(108, 184, 251);
-    Color medBlue = Color8u(160, 212, 250);
-    Color lightBlue = Color8u(174, 214, 246);
-
-    positions.push_back( vec3( +0.5, -0.5, +0.0 ) );
-    positions.push_back( vec3( -0.5, -0.5, +0.0 ) );
-    colors.push_back( darkBlue );
-    colors.push_back( darkBlue );
-    positions.push_back( vec3( +0.5, -0.2, +0.0 ) );
-    positions.push_back( vec3( -0.5, -0.2, +0.0 ) );
-    colors.push_back( medBlue );
-    colors.push_back( medBlue );
-    positions.push_back( vec3( +0.5, +0.2, +0.0 ) );
-    positions.push_back( vec3( -0.5, +0.2, +0.0 ) );
-    colors.push_back( medBlue );
-    colors.push_back( medBlue );
-    positions.push_back( vec3( +0.5, +0.5, +0.0 ) );
-    positions.push_back( vec3( -0.5, +0.5, +0.0 ) );
-    colors.push_back( lightBlue );
-    colors.push_back( lightBlue );
-
-    std::vector<gl::VboMesh::Layout> bufferLayout = {
-        gl::VboMesh::Layout().usage( GL_STATIC_DRAW ).attrib( geom::Attrib::POSITION, 3 ),
-        gl::VboMesh::Layout().usage( GL_STATIC_DRAW ).attrib( geom::Attrib::COLOR, 3 ),
-    };
-    gl::VboMeshRef mesh = gl::VboMesh::create( positions.size(), GL_TRIANGLE_STRIP, bufferLayout );
-    mesh->bufferAttrib( geom::Attrib::POSITION, positions );
-    mesh->bufferAttrib( geom::Attrib::COLOR, colors );
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <set>
+#include <unordered_map>
 
-    gl::GlslProgRef colorShader = gl::getStockShader( gl::ShaderDef().color() );
-
-    return gl::Batch::create( mesh, colorShader );
-}
+using namespace ci;
 
 ci::gl::BatchRef buildGround( const Cityscape::CityModel &model )
 {
@@ -63,12 +36,189 @@ ci::gl::BatchRef buildGround( const Cityscape::CityModel &model )
     return gl::Batch::create( plane >> geom::Constant( geom::Attrib::COLOR, model.groundColor ), colorShader );
 }
 
-gl::BatchRef buildBatch( const gl::GlslProgRef &shader, const geom::SourceMods &geometry, const std::vector<CityView::InstanceData> &instances )
+// A shape for a ground layer along with the district, block, lot or pavement
+// it came from. Updates go by the owner to tell if it's still around.
+struct GroundShape {
+    std::shared_ptr<const void> owner;
+    FlatShapeRef                shape;
+    ColorA                      color;
+};
+typedef std::vector<GroundShape> GroundShapes;
+
+// Triangulates shapes at height, numbering their vertices from base and
+// noting where each one's indices landed, counting from firstIndex.
+void meshGroundShapes( const std::vector<const GroundShape*> &shapes, float height, uint32_t base, uint32_t firstIndex,
+    std::vector<vec3> &positions, std::vector<ColorA> &colors, std::vector<uint32_t> &indices, std::vector<std::pair<GLint, GLsizei>> &ranges )
+{
+    for ( const GroundShape *shape : shapes ) {
+        const TriMeshRef &mesh = shape->shape->mesh();
+        assert( mesh->getPositionDims() == 2 );
+        const vec2 *points = mesh->getPositions<2>();
+        const size_t vertexCount = mesh->getNumVertices();
+        const uint32_t offset = base + positions.size();
+
+        ranges.push_back( std::make_pair( GLint( firstIndex + indices.size() ), GLsizei( mesh->getNumIndices() ) ) );
+        for ( size_t i = 0; i < vertexCount; ++i ) {
+            positions.push_back( vec3( points[i], height ) );
+        }
+        colors.insert( colors.end(), vertexCount, shape->color );
+        for ( uint32_t index : mesh->getIndices() ) {
+            indices.push_back( offset + index );
+        }
+    }
+}
+
+CityView::GroundLayer buildGroundLayer( const gl::GlslProgRef &shader, const GroundShapes &shapes, float height )
 {
-    size_t stride = sizeof( CityView::InstanceData );
+    CityView::GroundLayer layer;
+    if ( shapes.empty() ) return layer;
 
-    // create the VBO which will contain per-instance (rather than per-vertex) data
-    gl::VboRef vbo = gl::Vbo::create( GL_ARRAY_BUFFER, instances.size() * stride, instances.data(), GL_STATIC_DRAW );
+    std::vector<const GroundShape*> all;
+    for ( const auto &shape : shapes ) {
+        if ( layer.slots.insert( { shape.owner, all.size() } ).second ) all.push_back( &shape );
+    }
+    std::vector<vec3> positions;
+    std::vector<ColorA> colors;
+    std::vector<uint32_t> indices;
+    meshGroundShapes( all, height, 0, 0, positions, colors, indices, layer.ranges );
+
+    // Leave some room so small edits can be patched in.
+    layer.vertexCapacity = positions.size() + positions.size() / 2 + 1024;
+    layer.indexCapacity = indices.size() + indices.size() / 2 + 1024;
+    layer.usedVertices = positions.size();
+    layer.usedIndices = indices.size();
+
+    layer.positions = gl::Vbo::create( GL_ARRAY_BUFFER, layer.vertexCapacity * sizeof( vec3 ), nullptr, GL_DYNAMIC_DRAW );
+    layer.positions->bufferSubData( 0, positions.size() * sizeof( vec3 ), positions.data() );
+    layer.colors = gl::Vbo::create( GL_ARRAY_BUFFER, layer.vertexCapacity * sizeof( ColorA ), nullptr, GL_DYNAMIC_DRAW );
+    layer.colors->bufferSubData( 0, colors.size() * sizeof( ColorA ), colors.data() );
+    layer.indices = gl::Vbo::create( GL_ELEMENT_ARRAY_BUFFER, layer.indexCapacity * sizeof( uint32_t ), nullptr, GL_DYNAMIC_DRAW );
+    layer.indices->bufferSubData( 0, indices.size() * sizeof( uint32_t ), indices.data() );
+
+    geom::BufferLayout positionLayout, colorLayout;
+    positionLayout.append( geom::Attrib::POSITION, 3, 0, 0 );
+    colorLayout.append( geom::Attrib::COLOR, 4, 0, 0 );
+    gl::VboMeshRef mesh = gl::VboMesh::create( layer.vertexCapacity, GL_TRIANGLES,
+        { { positionLayout, layer.positions }, { colorLayout, layer.colors } },
+        layer.indexCapacity, GL_UNSIGNED_INT, layer.indices );
+
+    layer.batch = gl::Batch::create( mesh, shader );
+    return layer;
+}
+
+// Brings layer in line with shapes. Shapes that are gone have their indices
+// zeroed so their triangles draw nothing, new ones go in the spare room at
+// the end. Once that runs out, or half the indices are dead, the whole layer
+// is rebuilt.
+void patchGroundLayer( CityView::GroundLayer &layer, const gl::GlslProgRef &shader, const GroundShapes &shapes, float height )
+{
+    if ( !layer.batch ) {
+        layer = buildGroundLayer( shader, shapes, height );
+        return;
+    }
+
+    std::set<const void*> current;
+    for ( const auto &shape : shapes ) current.insert( shape.owner.get() );
+
+    std::vector<uint32_t> zeros;
+    for ( auto it = layer.slots.begin(); it != layer.slots.end(); ) {
+        if ( current.count( it->first.get() ) ) {
+            ++it;
+            continue;
+        }
+        auto &range = layer.ranges[it->second];
+        if ( range.second ) {
+            zeros.assign( range.second, 0 );
+            layer.indices->bufferSubData( range.first * sizeof( uint32_t ), zeros.size() * sizeof( uint32_t ), zeros.data() );
+        }
+        layer.freedIndices += range.second;
+        range.second = 0;
+        it = layer.slots.erase( it );
+    }
+
+    std::vector<const GroundShape*> added;
+    for ( const auto &shape : shapes ) {
+        if ( !layer.slots.count( shape.owner ) ) added.push_back( &shape );
+    }
+
+    if ( layer.freedIndices > layer.usedIndices / 2 ) {
+        layer = buildGroundLayer( shader, shapes, height );
+        return;
+    }
+    if ( added.empty() ) return;
+
+    std::vector<vec3> positions;
+    std::vector<ColorA> colors;
+    std::vector<uint32_t> indices;
+    std::vector<std::pair<GLint, GLsizei>> ranges;
+    meshGroundShapes( added, height, layer.usedVertices, layer.usedIndices, positions, colors, indices, ranges );
+    if ( layer.usedVertices + positions.size() > layer.vertexCapacity || layer.usedIndices + indices.size() > layer.indexCapacity ) {
+        layer = buildGroundLayer( shader, shapes, height );
+        return;
+    }
+
+    layer.positions->bufferSubData( layer.usedVertices * sizeof( vec3 ), positions.size() * sizeof( vec3 ), positions.data() );
+    layer.colors->bufferSubData( layer.usedVertices * sizeof( ColorA ), colors.size() * sizeof( ColorA ), colors.data() );
+    layer.indices->bufferSubData( layer.usedIndices * sizeof( uint32_t ), indices.size() * sizeof( uint32_t ), indices.data() );
+    layer.usedVertices += positions.size();
+    layer.usedIndices += indices.size();
+    for ( size_t i = 0; i < added.size(); ++i ) {
+        if ( layer.slots.insert( { added[i]->owner, layer.ranges.size() } ).second ) layer.ranges.push_back( ranges[i] );
+    }
+}
+
+void CityView::InstanceBatch::add( const mat4 &transform, const ColorA &color )
+{
+    if ( !fullMatrices ) {
+        if ( auto packed = InstanceData::pack( transform, color ) ) {
+            instances.push_back( *packed );
+            return;
+        }
+        makeFull();
+    }
+    fullInstances.push_back( FullInstanceData( transform, color ) );
+}
+
+void CityView::InstanceBatch::append( InstanceBatch &&other )
+{
+    if ( other.fullMatrices && !fullMatrices ) makeFull();
+
+    // Nothing here yet, take theirs.
+    if ( !size() && other.fullMatrices == fullMatrices ) {
+        instances.swap( other.instances );
+        fullInstances.swap( other.fullInstances );
+        return;
+    }
+
+    if ( !fullMatrices ) {
+        instances.insert( instances.end(), other.instances.begin(), other.instances.end() );
+    } else if ( other.fullMatrices ) {
+        fullInstances.insert( fullInstances.end(), other.fullInstances.begin(), other.fullInstances.end() );
+    } else {
+        fullInstances.insert( fullInstances.end(), other.instances.begin(), other.instances.end() );
+    }
+}
+
+void CityView::InstanceBatch::makeFull()
+{
+    // Everything already here comes along, and the level buffers are the
+    // wrong layout now.
+    fullMatrices = true;
+    fullInstances.assign( instances.begin(), instances.end() );
+    instances.clear();
+    capacity = 0;
+}
+
+// A level drawn with its own batch, with a matrix per instance. The level's
+// instance buffer starts out empty, culling fills it in.
+CityView::InstanceBatch::Level buildLevel( const gl::GlslProgRef &shader, const gl::VboMeshRef &mesh, size_t capacity )
+{
+    size_t stride = sizeof( FullInstanceData );
+
+    // create the VBO which will contain per-instance (rather than per-vertex) data,
+    // it's big enough for every instance to be drawn at this level and
+    // culling rewrites it as the camera moves.
+    gl::VboRef vbo = gl::Vbo::create( GL_ARRAY_BUFFER, capacity * stride, nullptr, GL_DYNAMIC_DRAW );
 
     // we need a geom::BufferLayout to describe this data as mapping to the CUSTOM_0 semantic,
     // and the 1 (rather than 0) as the last param indicates per-instance (rather than per-vertex)
@@ -79,104 +229,783 @@ gl::BatchRef buildBatch( const gl::GlslProgRef &shader, const geom::SourceMods &
     layout.append( geom::Attrib::CUSTOM_0, matrixDim, stride, 0, 1 );
     layout.append( geom::Attrib::COLOR, colorDim, stride, sizeof( ci::mat4 ), 1 );
 
-    gl::VboMeshRef mesh = gl::VboMesh::create( geometry );
     mesh->appendVbo( layout, vbo );
 
-    return gl::Batch::create( mesh, shader, { { geom::Attrib::CUSTOM_0, "vInstanceModelMatrix" }, { geom::Attrib::COLOR, "vInstanceColor" } } );
+    CityView::InstanceBatch::Level level;
+    level.batch = gl::Batch::create( mesh, shader, { { geom::Attrib::CUSTOM_0, "vInstanceModelMatrix" }, { geom::Attrib::COLOR, "vInstanceColor" } } );
+    level.vbo = vbo;
+    return level;
 }
 
+// (Re)creates the levels of a batch with full matrices, with room for all its
+// instances and then some. The scenery's geometry is only uploaded if an
+// earlier view hasn't already.
+void buildBatch( CityView::InstanceBatch &batch, bool plant )
+{
+    GpuResources &resources = GpuResources::shared();
+    gl::GlslProgRef shader = plant ? resources.treeShader( batch.fullMatrices ) : resources.buildingShader( batch.fullMatrices );
+    batch.capacity = batch.size() + batch.size() / 2;
+    batch.levels.clear();
+    for ( size_t i = 0; i < batch.scenery->levelsOfDetail(); ++i ) {
+        batch.levels.push_back( buildLevel( shader, resources.mesh( batch.scenery, i ), batch.capacity ) );
+    }
+}
 
-typedef std::map<SceneryRef, std::vector<CityView::InstanceData>> GroupedScenery;
+bool multiDrawIndirectAvailable()
+{
+#if defined( GL_VERSION_4_3 )
+    static const bool available = gl::getVersion() >= std::make_pair( 4, 3 ) || gl::isExtensionAvailable( "GL_ARB_multi_draw_indirect" );
+    return available;
+#else
+    // Not even declared, as with the 4.1 headers on OS X.
+    return false;
+#endif
+}
 
-void collectInstanceData( GroupedScenery &data, const Scenery::Instance &instance )
+// Gives every level of the batches that aren't using full matrices a slice
+// of one instance buffer and their spot in the packed geometry.
+CityView::IndirectPass buildPass( std::vector<CityView::InstanceBatch> &batches, const gl::GlslProgRef &shader )
 {
-    if( instance.children.size() ) {
-        for( auto child : instance.children ) {
-            collectInstanceData( data, child );
+    GpuResources &resources = GpuResources::shared();
+    CityView::IndirectPass pass;
+    pass.shader = shader;
+
+    size_t instanceCount = 0;
+    size_t levelCount = 0;
+    for ( auto &batch : batches ) {
+        if ( batch.fullMatrices ) continue;
+        batch.capacity = batch.size();
+        batch.levels.clear();
+        // Nothing to draw, so don't pack its geometry.
+        if ( !batch.size() ) continue;
+        for ( size_t i = 0; i < batch.scenery->levelsOfDetail(); ++i ) {
+            CityView::InstanceBatch::Level level;
+            level.mesh = resources.packedMesh( batch.scenery, i );
+            level.firstInstance = instanceCount;
+            instanceCount += batch.size();
+            batch.levels.push_back( level );
+        }
+        levelCount += batch.levels.size();
+    }
+    if ( !instanceCount ) return pass;
+
+    pass.positions = resources.packedPositions();
+    pass.indices = resources.packedIndices();
+    pass.instances = gl::Vbo::create( GL_ARRAY_BUFFER, instanceCount * sizeof( InstanceData ), nullptr, GL_DYNAMIC_DRAW );
+    for ( auto &batch : batches ) {
+        if ( batch.fullMatrices ) continue;
+        for ( auto &level : batch.levels ) level.vbo = pass.instances;
+    }
+#if defined( GL_VERSION_4_3 )
+    if ( multiDrawIndirectAvailable() ) {
+        pass.commandBuffer = gl::Vbo::create( GL_DRAW_INDIRECT_BUFFER, levelCount * sizeof( CityView::IndirectPass::Command ), nullptr, GL_DYNAMIC_DRAW );
+    }
+#endif
+
+    pass.positionLocation = shader->getAttribLocation( "vInstancePosition" );
+    pass.axesLocation = shader->getAttribLocation( "vInstanceAxes" );
+    pass.colorLocation = shader->getAttribLocation( "vInstanceColor" );
+
+    pass.vao = gl::Vao::create();
+    gl::ScopedVao scopedVao( pass.vao );
+    {
+        gl::ScopedBuffer scopedPositions( pass.positions );
+        GLint location = shader->getAttribSemanticLocation( geom::Attrib::POSITION );
+        gl::enableVertexAttribArray( location );
+        gl::vertexAttribPointer( location, 3, GL_FLOAT, GL_FALSE, 0, nullptr );
+    }
+    // The element buffer is part of the vao so it stays bound.
+    pass.indices->bind();
+    {
+        gl::ScopedBuffer scopedInstances( pass.instances );
+        for ( GLint location : { pass.positionLocation, pass.axesLocation, pass.colorLocation } ) {
+            if ( location < 0 ) continue;
+            gl::enableVertexAttribArray( location );
+            gl::vertexAttribDivisor( location, 1 );
+        }
+        pass.pointInstances( 0 );
+    }
+    return pass;
+}
+
+void CityView::IndirectPass::pointInstances( GLuint first ) const
+{
+    const size_t stride = sizeof( InstanceData );
+    auto at = [&]( size_t member ) { return reinterpret_cast<const GLvoid*>( first * stride + member ); };
+    if ( positionLocation >= 0 ) {
+        gl::vertexAttribPointer( positionLocation, 3, GL_FLOAT, GL_FALSE, stride, at( offsetof( InstanceData, position ) ) );
+    }
+    if ( axesLocation >= 0 ) {
+        gl::vertexAttribPointer( axesLocation, 4, GL_HALF_FLOAT, GL_FALSE, stride, at( offsetof( InstanceData, axes ) ) );
+    }
+    if ( colorLocation >= 0 ) {
+        gl::vertexAttribIPointer( colorLocation, 1, GL_INT, stride, at( offsetof( InstanceData, color ) ) );
+    }
+}
+
+void CityView::IndirectPass::setCommands( const std::vector<InstanceBatch> &batches ) const
+{
+    commands.clear();
+    for ( const auto &batch : batches ) {
+        if ( batch.fullMatrices ) continue;
+        for ( const auto &level : batch.levels ) {
+            if ( !level.visible ) continue;
+            commands.push_back( { level.mesh.indexCount, GLuint( level.visible ), level.mesh.firstIndex, level.mesh.baseVertex, GLuint( level.firstInstance ) } );
+        }
+    }
+    if ( commandBuffer && commands.size() ) {
+        commandBuffer->bufferSubData( 0, commands.size() * sizeof( Command ), commands.data() );
+    }
+}
+
+void CityView::IndirectPass::draw() const
+{
+    if ( !vao || commands.empty() ) return;
+
+    gl::ScopedGlslProg scopedShader( shader );
+    gl::setDefaultShaderVars();
+    gl::ScopedVao scopedVao( vao );
+#if defined( GL_VERSION_4_3 )
+    if ( commandBuffer ) {
+        gl::ScopedBuffer scopedCommands( commandBuffer );
+        glMultiDrawElementsIndirect( GL_TRIANGLES, GL_UNSIGNED_INT, nullptr, commands.size(), 0 );
+        return;
+    }
+#endif
+    // The next best thing, point the instances at each command's slice in
+    // turn. The vao's only ever drawn this way so they needn't be put back.
+    gl::ScopedBuffer scopedInstances( instances );
+    for ( const Command &command : commands ) {
+        pointInstances( command.baseInstance );
+        glDrawElementsInstancedBaseVertex( GL_TRIANGLES, command.count, GL_UNSIGNED_INT,
+            reinterpret_cast<const GLvoid*>( command.firstIndex * sizeof( uint32_t ) ), command.instanceCount, command.baseVertex );
+    }
+}
+
+// Splits a lot's instances into batches by scenery and notes on the lot's
+// node where they went. Everything a lot adds to a batch ends up side by side
+// at the end so it can be skipped as a single range.
+struct InstanceCollector {
+    InstanceCollector( std::vector<CityView::InstanceBatch> &batches, bool plant )
+        : batches( batches ), plant( plant )
+    {
+        for ( uint32_t i = 0; i < batches.size(); ++i ) {
+            index.insert( { batches[i].scenery, i } );
+        }
+    }
+
+    void collect( const InstanceTable &table, CityView::CullNode &node )
+    {
+        const size_t firstRange = node.ranges.size();
+        for ( size_t i = 0; i < table.size(); ++i ) {
+            auto found = index.find( table.scenery[i] );
+            if ( found == index.end() ) {
+                found = index.insert( { table.scenery[i], uint32_t( batches.size() ) } ).first;
+                batches.push_back( CityView::InstanceBatch() );
+                batches.back().scenery = table.scenery[i];
+            }
+            CityView::InstanceBatch &batch = batches[found->second];
+
+            auto range = std::find_if( node.ranges.begin() + firstRange, node.ranges.end(),
+                [&]( const CityView::CullNode::Range &r ) { return r.batch == found->second; } );
+            if ( range == node.ranges.end() ) {
+                node.ranges.push_back( { plant, found->second, batch.size(), 0 } );
+                range = node.ranges.end() - 1;
+            }
+            range->count++;
+            batch.add( table.transforms[i], table.colors[i] );
+        }
+    }
+
+    std::vector<CityView::InstanceBatch>    &batches;
+    const bool                              plant;
+    std::unordered_map<SceneryRef, uint32_t> index;
+};
+
+// Squeezes out the instances of removed lots, but only once they're at least
+// half of a batch so it's not redone on every edit.
+void compactBatches( std::vector<CityView::InstanceBatch> &batches, bool plant, std::vector<CityView::CullNode> &tree )
+{
+    std::vector<bool> compacting( batches.size(), false );
+    bool any = false;
+    for ( size_t i = 0; i < batches.size(); ++i ) {
+        if ( batches[i].freed && batches[i].freed * 2 >= batches[i].size() ) {
+            compacting[i] = any = true;
+        }
+    }
+    if ( !any ) return;
+
+    std::vector<CityView::InstanceBatch> compacted( batches.size() );
+    std::function<void(CityView::CullNode&)> walk = [&]( CityView::CullNode &node ) {
+        for ( auto &range : node.ranges ) {
+            if ( range.plant != plant || !compacting[range.batch] ) continue;
+            const CityView::InstanceBatch &from = batches[range.batch];
+            CityView::InstanceBatch &to = compacted[range.batch];
+            const size_t first = range.first;
+            if ( from.fullMatrices ) {
+                range.first = to.fullInstances.size();
+                to.fullInstances.insert( to.fullInstances.end(), from.fullInstances.begin() + first, from.fullInstances.begin() + first + range.count );
+            } else {
+                range.first = to.instances.size();
+                to.instances.insert( to.instances.end(), from.instances.begin() + first, from.instances.begin() + first + range.count );
+            }
+        }
+        for ( auto &child : node.children ) walk( child );
+    };
+    for ( auto &node : tree ) walk( node );
+
+    for ( size_t i = 0; i < batches.size(); ++i ) {
+        if ( !compacting[i] ) continue;
+        batches[i].instances.swap( compacted[i].instances );
+        batches[i].fullInstances.swap( compacted[i].fullInstances );
+        batches[i].freed = 0;
+    }
+}
+
+// Drops the batches that compacting has left empty, renumbering the ranges
+// that point past them. The empty ones' scenery goes into dropped, nothing in
+// the view holds on to it after this.
+void pruneBatches( std::vector<CityView::InstanceBatch> &batches, bool plant, std::vector<CityView::CullNode> &tree,
+    std::vector<std::weak_ptr<const Scenery>> &dropped )
+{
+    std::vector<uint32_t> renumbered( batches.size() );
+    std::vector<CityView::InstanceBatch> kept;
+    kept.reserve( batches.size() );
+    for ( size_t i = 0; i < batches.size(); ++i ) {
+        if ( !batches[i].size() ) {
+            dropped.push_back( batches[i].scenery );
+            continue;
+        }
+        renumbered[i] = kept.size();
+        kept.push_back( std::move( batches[i] ) );
+    }
+    if ( kept.size() == batches.size() ) return;
+
+    std::function<void(CityView::CullNode&)> walk = [&]( CityView::CullNode &node ) {
+        for ( auto &range : node.ranges ) {
+            if ( range.plant == plant ) range.batch = renumbered[range.batch];
+        }
+        for ( auto &child : node.children ) walk( child );
+    };
+    for ( auto &node : tree ) walk( node );
+    batches.swap( kept );
+}
+
+// Notes where the blocks and lots under node are by what they were built from.
+void indexNodes( const CityView::CullNode &node, std::map<std::shared_ptr<const void>, const CityView::CullNode*> &index )
+{
+    if ( node.owner ) index[node.owner] = &node;
+    for ( const auto &child : node.children ) indexNodes( child, index );
+}
+
+AxisAlignedBox cullBoundsOf( const FlatShapeRef &shape )
+{
+    // Trees can hang over the edge of their lot a bit, and nothing we build
+    // gets anywhere near this tall.
+    const float margin = 10;
+    const float height = 300;
+    Rectf r = shape->boundingBox();
+    return AxisAlignedBox( vec3( r.x1 - margin, r.y1 - margin, -1 ), vec3( r.x2 + margin, r.y2 + margin, height ) );
+}
+
+// The planes around the view volume, facing in, pulled out of the
+// model-view-projection matrix.
+struct ViewFrustum {
+    enum Result { OUTSIDE, INTERSECTS, INSIDE };
+
+    ViewFrustum( const mat4 &m )
+    {
+        vec4 row[4];
+        for ( int i = 0; i < 4; ++i ) {
+            row[i] = vec4( m[0][i], m[1][i], m[2][i], m[3][i] );
+        }
+        planes = { { row[3] + row[0], row[3] - row[0], row[3] + row[1], row[3] - row[1], row[3] + row[2], row[3] - row[2] } };
+    }
+
+    Result test( const AxisAlignedBox &box ) const
+    {
+        const vec3 &lo = box.getMin(), &hi = box.getMax();
+        Result result = INSIDE;
+        for ( const vec4 &plane : planes ) {
+            // The corners furthest along and furthest against the normal.
+            vec3 along( plane.x >= 0 ? hi.x : lo.x, plane.y >= 0 ? hi.y : lo.y, plane.z >= 0 ? hi.z : lo.z );
+            vec3 against( plane.x >= 0 ? lo.x : hi.x, plane.y >= 0 ? lo.y : hi.y, plane.z >= 0 ? lo.z : hi.z );
+            if ( glm::dot( vec3( plane ), along ) + plane.w < 0 ) return OUTSIDE;
+            if ( glm::dot( vec3( plane ), against ) + plane.w < 0 ) result = INTERSECTS;
+        }
+        return result;
+    }
+
+    std::array<vec4, 6> planes;
+};
+
+// Gathers the lots in view, noting which have their buildings drawn by their
+// block's proxy because the block is further than proxyDistance from eye.
+struct LotCollector {
+    LotCollector( const vec3 &eye, float proxyDistance ) : eye( eye ), proxyDistance( proxyDistance ) {}
+
+    // Pass a null frustum to take everything under node.
+    void collect( const CityView::CullNode &node, const ViewFrustum *frustum, bool proxied = false )
+    {
+        if ( frustum ) {
+            ViewFrustum::Result result = frustum->test( node.bounds );
+            if ( result == ViewFrustum::OUTSIDE ) return;
+            // No need to check anything underneath.
+            if ( result == ViewFrustum::INSIDE ) frustum = nullptr;
+        }
+
+        if ( node.proxy >= 0 && !proxied && glm::distance( eye, node.bounds.getCenter() ) > proxyDistance ) {
+            proxies.push_back( node.proxy );
+            proxied = true;
+        }
+        if ( !node.ranges.empty() ) lots.push_back( { &node, proxied } );
+        for ( const auto &child : node.children ) {
+            collect( child, frustum, proxied );
+        }
+    }
+
+    const vec3  eye;
+    const float proxyDistance;
+    std::vector<std::pair<const CityView::CullNode*, bool>> lots;
+    std::vector<int32_t> proxies;
+};
+
+// Every building on a block baked into one mesh at its simplest level of
+// detail. The building shader only looks at positions so the instances'
+// colors can go.
+struct ProxyBuilder {
+    void add( const InstanceTable &table )
+    {
+        for ( size_t i = 0; i < table.size(); ++i ) {
+            const TriMesh &mesh = simplest( table.scenery[i] );
+            const vec3 *points = mesh.getPositions<3>();
+            const uint32_t base = merged.getNumVertices();
+
+            positions.clear();
+            for ( size_t v = 0; v < mesh.getNumVertices(); ++v ) {
+                positions.push_back( vec3( table.transforms[i] * vec4( points[v], 1 ) ) );
+            }
+            indices.clear();
+            for ( uint32_t index : mesh.getIndices() ) {
+                indices.push_back( base + index );
+            }
+            merged.appendPositions( positions.data(), positions.size() );
+            merged.appendIndices( indices.data(), indices.size() );
+        }
+    }
+
+    // Hands back the merged mesh and starts a new one.
+    TriMesh take()
+    {
+        TriMesh result( TriMesh::Format().positions( 3 ) );
+        std::swap( result, merged );
+        return result;
+    }
+
+    const TriMesh& simplest( const SceneryRef &scenery )
+    {
+        auto found = meshes.find( scenery );
+        if ( found == meshes.end() ) {
+            const geom::SourceMods &geometry = scenery->geometry( scenery->levelsOfDetail() - 1 );
+            found = meshes.insert( { scenery, TriMesh( geometry, TriMesh::Format().positions( 3 ) ) } ).first;
+        }
+        return found->second;
+    }
+
+    TriMesh                         merged = TriMesh( TriMesh::Format().positions( 3 ) );
+    std::map<SceneryRef, TriMesh>   meshes;
+    std::vector<vec3>               positions;
+    std::vector<uint32_t>           indices;
+};
+
+// Orders instances by how far in front of the camera they are, nearest first
+// or furthest first. It's a radix sort on the depths, a byte per pass, which
+// doesn't care how jumbled they were to start with.
+vec3 positionOf( const InstanceData &instance ) { return instance.position; }
+vec3 positionOf( const FullInstanceData &instance ) { return vec3( instance.modelView[3] ); }
+
+template<typename T>
+void sortByDepth( std::vector<T> &instances, const vec3 &eye, const vec3 &forward, bool furthestFirst )
+{
+    const size_t count = instances.size();
+    if ( count < 2 ) return;
+
+    std::vector<uint32_t> keys( count ), order( count ), nextKeys( count ), nextOrder( count );
+    for ( size_t i = 0; i < count; ++i ) {
+        float depth = glm::dot( positionOf( instances[i] ) - eye, forward );
+        if ( furthestFirst ) depth = -depth;
+        // Flip the bits so the floats sort the same as unsigned ints: all of
+        // them for negatives, just the sign for positives.
+        uint32_t bits;
+        std::memcpy( &bits, &depth, sizeof( bits ) );
+        keys[i] = ( bits & 0x80000000u ) ? ~bits : ( bits | 0x80000000u );
+        order[i] = i;
+    }
+
+    for ( int shift = 0; shift < 32; shift += 8 ) {
+        std::array<size_t, 256> offsets = { { 0 } };
+        for ( uint32_t key : keys ) ++offsets[( key >> shift ) & 0xFF];
+        // Everything in one bucket means this byte doesn't change the order.
+        if ( offsets[( keys[0] >> shift ) & 0xFF] == count ) continue;
+
+        size_t start = 0;
+        for ( size_t &offset : offsets ) {
+            size_t bucket = offset;
+            offset = start;
+            start += bucket;
+        }
+        for ( size_t i = 0; i < count; ++i ) {
+            size_t to = offsets[( keys[i] >> shift ) & 0xFF]++;
+            nextKeys[to] = keys[i];
+            nextOrder[to] = order[i];
+        }
+        keys.swap( nextKeys );
+        order.swap( nextOrder );
+    }
+
+    std::vector<T> sorted;
+    sorted.reserve( count );
+    for ( uint32_t i : order ) sorted.push_back( instances[i] );
+    instances.swap( sorted );
+}
+
+// Sorts them if asked to and writes them to vbo starting at first. Hands
+// back how many there are.
+template<typename T>
+GLsizei uploadInstances( const gl::VboRef &vbo, size_t first, std::vector<T> &instances, bool sort, const vec3 &eye, const vec3 &forward, bool furthestFirst )
+{
+    if ( sort ) sortByDepth( instances, eye, forward, furthestFirst );
+    if ( instances.size() ) {
+        vbo->bufferSubData( first * sizeof( T ), instances.size() * sizeof( T ), instances.data() );
+    }
+    return instances.size();
+}
+
+// What one district adds to the view, worked out away from the main thread.
+struct DistrictView {
+    CityView::CullNode                      node;
+    // Instances of the lots that weren't there last time, with those lots'
+    // ranges pointing in here until they're merged.
+    std::vector<CityView::InstanceBatch>    buildings;
+    std::vector<CityView::InstanceBatch>    plants;
+    // Block and lot index of each of those lots.
+    std::vector<std::pair<size_t, size_t>>  newLots;
+    // By block index, old proxies to carry over and new ones to upload.
+    std::vector<std::pair<size_t, int32_t>> keptProxies;
+    std::vector<std::pair<size_t, TriMesh>> builtProxies;
+    GroundShapes                            blockShapes;
+    GroundShapes                            lotShapes;
+    std::vector<PolyLine2f>                 lotEdges;
+};
+
+// Only reads from previous so districts can be done side by side.
+void buildDistrictView( const Cityscape::DistrictRef &district, const std::map<std::shared_ptr<const void>, const CityView::CullNode*> &previous, DistrictView &view )
+{
+    InstanceCollector buildingCollector( view.buildings, false );
+    InstanceCollector plantCollector( view.plants, true );
+    ProxyBuilder proxyBuilder;
+
+    CityView::CullNode &districtNode = view.node;
+    districtNode.owner = district;
+    districtNode.bounds = cullBoundsOf( district->shape );
+    districtNode.children.resize( district->blocks.size() );
+
+    for ( size_t b = 0; b < district->blocks.size(); ++b ) {
+        const Cityscape::BlockRef &block = district->blocks[b];
+        view.blockShapes.push_back( { block, block->shape, block->color } );
+        CityView::CullNode &blockNode = districtNode.children[b];
+        blockNode.owner = block;
+        blockNode.bounds = cullBoundsOf( block->shape );
+        blockNode.children.resize( block->lots.size() );
+
+        for ( size_t l = 0; l < block->lots.size(); ++l ) {
+            const Cityscape::LotRef &lot = block->lots[l];
+            view.lotShapes.push_back( { lot, lot->shape, lot->color } );
+            CityView::CullNode &lotNode = blockNode.children[l];
+            lotNode.owner = lot;
+            lotNode.bounds = cullBoundsOf( lot->shape );
+
+            // Lots are never changed once they're laid out so if it was
+            // here last time its instances still are.
+            auto old = previous.find( lot );
+            if ( old != previous.end() ) {
+                lotNode.ranges = old->second->ranges;
+            } else {
+                buildingCollector.collect( lot->buildings, lotNode );
+                plantCollector.collect( lot->plants, lotNode );
+                view.newLots.push_back( { b, l } );
+            }
+
+            for ( seg2 side : lot->streetFacingSides ) {
+                view.lotEdges.push_back( PolyLine2f( { side.first, side.second } ) );
+            }
+        }
+
+        auto old = previous.find( block );
+        if ( old != previous.end() ) {
+            if ( old->second->proxy >= 0 ) view.keptProxies.push_back( { b, old->second->proxy } );
+            continue;
+        }
+
+        for ( const auto &lot : block->lots ) {
+            proxyBuilder.add( lot->buildings );
+        }
+        TriMesh proxy = proxyBuilder.take();
+        if ( proxy.getNumIndices() ) {
+            view.builtProxies.push_back( { b, std::move( proxy ) } );
+        }
+    }
+}
+
+// Moves a district's new instances onto the end of the view's batches and
+// points the new lots' ranges at where they ended up.
+void mergeBatches( std::vector<CityView::InstanceBatch> &batches, std::unordered_map<SceneryRef, uint32_t> &index,
+    std::vector<CityView::InstanceBatch> &from, bool plant, DistrictView &view )
+{
+    std::vector<uint32_t> batchFor( from.size() );
+    std::vector<size_t> offsetFor( from.size() );
+    for ( size_t i = 0; i < from.size(); ++i ) {
+        auto found = index.find( from[i].scenery );
+        if ( found == index.end() ) {
+            found = index.insert( { from[i].scenery, uint32_t( batches.size() ) } ).first;
+            batches.push_back( CityView::InstanceBatch() );
+            batches.back().scenery = from[i].scenery;
+        }
+        batchFor[i] = found->second;
+        offsetFor[i] = batches[found->second].size();
+        batches[found->second].append( std::move( from[i] ) );
+    }
+
+    for ( const auto &lot : view.newLots ) {
+        for ( auto &range : view.node.children[lot.first].children[lot.second].ranges ) {
+            if ( range.plant != plant ) continue;
+            range.first += offsetFor[range.batch];
+            range.batch = batchFor[range.batch];
         }
-    } else {
-        data[ instance.scenery ].push_back(
-            CityView::InstanceData(
-                instance.transformation,
-                instance.color
-            )
-        );
     }
 }
 
 CityView::CityView( const Cityscape::CityModel &model )
 {
-    gl::GlslProgRef colorShader = gl::getStockShader( gl::ShaderDef().color() );
+    sky = GpuResources::shared().sky();
+    update( model );
+}
+
+void CityView::update( const Cityscape::CityModel &model )
+{
+    GpuResources &resources = GpuResources::shared();
+
+    gl::GlslProgRef colorShader = resources.colorShader();
+    gl::GlslProgRef buildingShader = resources.buildingShader( false );
 
-    gl::GlslProgRef buildingShader = ci::gl::GlslProg::create(
-       app::loadResource( RES_BUILDING_VERT ),
-       app::loadResource( RES_BUILDING_FRAG )
-    );
-    float hue = 0.1;
-    buildingShader->uniform( "darkColor",   Color( CM_HSV, hue, 0.60, 0.25 ) );
-    buildingShader->uniform( "mediumColor", Color( CM_HSV, hue, 0.55, 0.66 ) );
-    buildingShader->uniform( "lightColor",  Color( CM_HSV, hue, 0.15, 1.00 ) );
-
-    gl::GlslProgRef treeShader = ci::gl::GlslProg::create(
-       app::loadResource( RES_TREE_VERT ),
-       app::loadResource( RES_TREE_FRAG )
-    );
-
-    sky = buildSky();
     ground = buildGround( model );
 
+    GroundShapes roadShapes, districtShapes, blockShapes, lotShapes;
+
     for ( const auto &shape : model.pavement ) {
-        auto mesh = *shape->mesh() >> geom::Constant( geom::Attrib::COLOR, model.roadColor );
-        roads.push_back( gl::Batch::create( mesh, colorShader ) );
+        roadShapes.push_back( { shape, shape, model.roadColor } );
+    }
+    for ( const auto &district : model.districts ) {
+        for ( const auto &shape : district->pavement ) {
+            roadShapes.push_back( { shape, shape, model.roadColor } );
+        }
     }
 
-    GroupedScenery buildingData;
-    GroupedScenery plantData;
+    // The blocks and lots from last time, whatever's left once this layout's
+    // have been matched up is gone.
+    std::map<std::shared_ptr<const void>, const CullNode*> previous;
+    for ( const auto &node : cullTree ) {
+        indexNodes( node, previous );
+    }
 
-    for ( const auto &district : model.districts ) {
-        auto mesh = *district->shape->mesh()
-            >> geom::Constant( geom::Attrib::COLOR, district->color )
-            >> geom::Translate( vec3( 0, 0, -0.03 ) );
-        districts.push_back( gl::Batch::create( mesh, colorShader ) );
-
-        for ( const auto &block : district->blocks ) {
-            auto mesh = *block->shape->mesh()
-                >> geom::Constant( geom::Attrib::COLOR, block->color )
-                >> geom::Translate( vec3( 0, 0, -0.02 ) );
-            blocks.push_back( gl::Batch::create( mesh, colorShader ) );
-
-            for ( const auto &lot : block->lots ) {
-                auto mesh = *lot->shape->mesh()
-                    >> geom::Constant( geom::Attrib::COLOR, lot->color )
-                    >> geom::Translate( vec3( 0, 0, -0.01 ) );
-                lots.push_back( gl::Batch::create( mesh, colorShader ) );
-
-                for ( const auto &instance : lot->buildings ) {
-                    collectInstanceData( buildingData, instance );
-                }
+    // Each proxy drawn once, right where it is. There are few enough of
+    // them that they get a whole matrix and their own batches.
+    const FullInstanceData identity( mat4(), vec4( 1 ) );
+    gl::GlslProgRef proxyShader = resources.buildingShader( true );
 
-                for ( const auto &instance : lot->plants ) {
-                    collectInstanceData( plantData, instance );
-                }
+    // The slow part, sorting out the new lots' instances and merging the
+    // new blocks' proxies, is done a district at a time in parallel.
+    std::vector<DistrictView> views( model.districts.size() );
+    Cityscape::parallelFor( views.size(), [&]( size_t i ) {
+        buildDistrictView( model.districts[i], previous, views[i] );
+    } );
 
-                for ( seg2 side : lot->streetFacingSides ) {
-                    lotEdges.push_back( PolyLine2f( { side.first, side.second } ) );
-                }
+    std::unordered_map<SceneryRef, uint32_t> buildingIndex, plantIndex;
+    for ( uint32_t i = 0; i < buildings.size(); ++i ) buildingIndex.insert( { buildings[i].scenery, i } );
+    for ( uint32_t i = 0; i < plants.size(); ++i ) plantIndex.insert( { plants[i].scenery, i } );
+
+    std::vector<CullNode> tree;
+    std::vector<InstanceBatch::Level> proxies;
+    lotEdges.clear();
+
+    for ( size_t i = 0; i < views.size(); ++i ) {
+        const Cityscape::DistrictRef &district = model.districts[i];
+        DistrictView &view = views[i];
+        districtShapes.push_back( { district, district->shape, district->color } );
+        blockShapes.insert( blockShapes.end(), view.blockShapes.begin(), view.blockShapes.end() );
+        lotShapes.insert( lotShapes.end(), view.lotShapes.begin(), view.lotShapes.end() );
+        lotEdges.insert( lotEdges.end(), view.lotEdges.begin(), view.lotEdges.end() );
+
+        mergeBatches( buildings, buildingIndex, view.buildings, false, view );
+        mergeBatches( plants, plantIndex, view.plants, true, view );
+
+        for ( const auto &kept : view.keptProxies ) {
+            view.node.children[kept.first].proxy = proxies.size();
+            proxies.push_back( blockProxies[kept.second] );
+        }
+        for ( const auto &built : view.builtProxies ) {
+            view.node.children[built.first].proxy = proxies.size();
+            proxies.push_back( buildLevel( proxyShader, gl::VboMesh::create( built.second ), 1 ) );
+            proxies.back().vbo->bufferSubData( 0, sizeof( FullInstanceData ), &identity );
+        }
+
+        // Anything still here isn't gone.
+        for ( const auto &block : view.node.children ) {
+            previous.erase( block.owner );
+            for ( const auto &lot : block.children ) previous.erase( lot.owner );
+        }
+        tree.push_back( std::move( view.node ) );
+    }
+
+    for ( const auto &gone : previous ) {
+        for ( const auto &range : gone.second->ranges ) {
+            ( range.plant ? plants : buildings )[range.batch].freed += range.count;
+        }
+    }
+    // Nothing from the old tree is needed past here.
+    cullTree.swap( tree );
+    tree.clear();
+    blockProxies.swap( proxies );
+    proxies.clear();
+    mVisibleLots.clear();
+
+    patchGroundLayer( roads, colorShader, roadShapes, 0 );
+    patchGroundLayer( districts, colorShader, districtShapes, -0.03 );
+    patchGroundLayer( blocks, colorShader, blockShapes, -0.02 );
+    patchGroundLayer( lots, colorShader, lotShapes, -0.01 );
+
+    compactBatches( buildings, false, cullTree );
+    compactBatches( plants, true, cullTree );
+    // Batches only stay around while some lot uses them, otherwise they'd
+    // keep every plan this view has ever drawn alive, and its buffers with it.
+    std::vector<std::weak_ptr<const Scenery>> dropped;
+    pruneBatches( buildings, false, cullTree, dropped );
+    pruneBatches( plants, true, cullTree, dropped );
+
+    // Whatever the last view had that this one doesn't is gone by now.
+    resources.purge();
+    for ( const auto &scenery : dropped ) {
+        // Unless something outside the view, like the plan cache, still
+        // wants it its buffers should be gone.
+        assert( !scenery.expired() || !resources.holds( scenery ) );
+    }
+
+    // The level buffers are packed fresh on the next draw. Those of batches
+    // with full matrices only need replacing if they've run out of room, the
+    // rest get slices of a new pass.
+    auto prepare = [&]( std::vector<InstanceBatch> &batches, bool plant ) {
+        for ( auto &batch : batches ) {
+            if ( batch.fullMatrices && batch.size() > batch.capacity ) {
+                buildBatch( batch, plant );
             }
+            for ( const auto &level : batch.levels ) level.visible = 0;
         }
+    };
+    prepare( plants, true );
+    prepare( buildings, false );
+    plantPass = buildPass( plants, resources.treeShader( false ) );
+    buildingPass = buildPass( buildings, buildingShader );
+}
+
+void CityView::cullScenery( const Options &options ) const
+{
+    ViewFrustum frustum( gl::getModelViewProjection() );
+    const mat4 camera = glm::inverse( gl::getViewMatrix() );
+    const vec3 eye = vec3( camera[3] );
+    const vec3 forward = -vec3( camera[2] );
+    LotCollector inView( eye, options.proxyDistance );
+    inView.lots.reserve( mVisibleLots.size() );
+    for ( const auto &node : cullTree ) {
+        inView.collect( node, options.cullScenery ? &frustum : nullptr );
     }
 
-    for ( auto &pair : plantData ) {
-        auto plan = pair.first;
-        auto instances = pair.second;
-        plants.push_back( InstanceBatch( buildBatch( treeShader, plan->geometry(), instances ), instances.size() ) );
+    // Proxies are a single instance so there's nothing to upload.
+    for ( const auto &proxy : blockProxies ) proxy.visible = 0;
+    for ( int32_t proxy : inView.proxies ) blockProxies[proxy].visible = 1;
+
+    // Level of detail goes by lot rather than instance, it's cheaper and
+    // keeps a lot's trees looking alike.
+    // Past the simplest level there's nothing to change.
+    size_t deepest = 1;
+    for ( const auto &batch : buildings ) deepest = std::max( deepest, batch.levels.size() );
+    for ( const auto &batch : plants ) deepest = std::max( deepest, batch.levels.size() );
+
+    VisibleLots visible;
+    visible.reserve( inView.lots.size() );
+    for ( const auto &lot : inView.lots ) {
+        float steps = glm::distance( eye, lot.first->bounds.getCenter() ) / std::max( options.lodDistance, 1.0f );
+        visible.push_back( { lot.first, uint32_t( std::min( steps, float( deepest - 1 ) ) ), lot.second } );
     }
+    // Only bother re-sorting once the camera has moved or turned enough for
+    // the order to be noticeably off.
+    const bool resort = options.sortScenery
+        && ( glm::distance( eye, mSortedEye ) > options.resortDistance || glm::dot( forward, mSortedForward ) < 0.98f );
+    if ( visible == mVisibleLots && !resort ) return;
+    mVisibleLots.swap( visible );
+    if ( options.sortScenery ) {
+        mSortedEye = eye;
+        mSortedForward = forward;
+    }
+
+    // Only the one matching the batch's format gets used.
+    struct PackedLevel {
+        std::vector<InstanceData>       compact;
+        std::vector<FullInstanceData>   full;
+    };
+    // Indexed by batch then level.
+    typedef std::vector<std::vector<PackedLevel>> Packed;
+    auto sized = []( const std::vector<InstanceBatch> &batches ) {
+        Packed packed( batches.size() );
+        for ( size_t i = 0; i < batches.size(); ++i ) packed[i].resize( batches[i].levels.size() );
+        return packed;
+    };
+    Packed packedBuildings = sized( buildings ), packedPlants = sized( plants );
 
-    for ( auto &pair : buildingData ) {
-        auto plan = pair.first;
-        auto instances = pair.second;
-        buildings.push_back( InstanceBatch( buildBatch( buildingShader, plan->geometry(), instances ), instances.size() ) );
+    for ( const auto &lot : mVisibleLots ) {
+        for ( const CullNode::Range &range : lot.node->ranges ) {
+            if ( lot.proxied && !range.plant ) continue;
+            const InstanceBatch &batch = range.plant ? plants[range.batch] : buildings[range.batch];
+            auto &levels = range.plant ? packedPlants[range.batch] : packedBuildings[range.batch];
+            auto &packed = levels[ std::min<size_t>( lot.level, levels.size() - 1 ) ];
+            if ( batch.fullMatrices ) {
+                auto first = batch.fullInstances.begin() + range.first;
+                packed.full.insert( packed.full.end(), first, first + range.count );
+            } else {
+                auto first = batch.instances.begin() + range.first;
+                packed.compact.insert( packed.compact.end(), first, first + range.count );
+            }
+        }
     }
+
+    auto upload = [&]( const std::vector<InstanceBatch> &batches, Packed &packed, bool furthestFirst ) {
+        for ( size_t i = 0; i < batches.size(); ++i ) {
+            for ( size_t l = 0; l < batches[i].levels.size(); ++l ) {
+                const auto &level = batches[i].levels[l];
+                auto &data = packed[i][l];
+                if ( batches[i].fullMatrices ) {
+                    level.visible = uploadInstances( level.vbo, level.firstInstance, data.full, options.sortScenery, eye, forward, furthestFirst );
+                } else {
+                    level.visible = uploadInstances( level.vbo, level.firstInstance, data.compact, options.sortScenery, eye, forward, furthestFirst );
+                }
+            }
+        }
+    };
+    // Opaque buildings go nearest first so the depth test throws out what's
+    // behind them, the see through trees furthest first so they blend.
+    upload( buildings, packedBuildings, false );
+    upload( plants, packedPlants, true );
+    buildingPass.setCommands( buildings );
+    plantPass.setCommands( plants );
 }
 
 void CityView::draw( const Options &options ) const
@@ -200,18 +1029,10 @@ void CityView::draw( const Options &options ) const
 
     // Transparent ground layers are ordered from the ground up so we're ignoring
     // further depth sorting.
-    if ( options.drawRoads ) {
-        for ( const auto &batch : roads ) batch->draw();
-    }
-    if ( options.drawDistricts ) {
-        for ( const auto &batch : districts ) batch->draw();
-    }
-    if ( options.drawBlocks ) {
-        for ( const auto &batch : blocks ) batch->draw();
-    }
-    if ( options.drawLots ) {
-        for ( const auto &batch : lots ) batch->draw();
-    }
+    if ( options.drawRoads ) roads.draw();
+    if ( options.drawDistricts ) districts.draw();
+    if ( options.drawBlocks ) blocks.draw();
+    if ( options.drawLots ) lots.draw();
     if ( options.drawLotEdges ) {
         gl::ScopedColor color( Color::black() );
         for ( const auto &edge : lotEdges ) {
@@ -219,18 +1040,33 @@ void CityView::draw( const Options &options ) const
         }
     }
 
-    // Draw opaque objects. TODO: sort front-to-back to aid z-culling.
+    if ( options.drawBuildings || options.drawPlants ) {
+        cullScenery( options );
+    }
+
+    // Draw opaque objects, each batch is sorted front-to-back to aid z-culling.
+    // Nearly everything goes out with the pass, only scenery that needs
+    // full matrices gets its own draw calls.
     if ( options.drawBuildings ) {
         gl::ScopedFaceCulling faceCullScope( true, GL_BACK );
+        buildingPass.draw();
         for ( const auto &buildingbits : buildings ) {
-            buildingbits.first->drawInstanced( buildingbits.second );
+            for ( const auto &level : buildingbits.levels ) {
+                if ( level.batch && level.visible ) level.batch->drawInstanced( level.visible );
+            }
+        }
+        for ( const auto &proxy : blockProxies ) {
+            if ( proxy.visible ) proxy.batch->drawInstanced( proxy.visible );
         }
     }
-    // Draw transparent objects. TODO: should sort them back to front
+    // Draw transparent objects, each batch is sorted back to front.
     if ( options.drawPlants ) {
         gl::ScopedFaceCulling faceCullScope( true, GL_BACK );
+        plantPass.draw();
         for ( const auto &plant : plants ) {
-            plant.first->drawInstanced( plant.second );
+            for ( const auto &level : plant.levels ) {
+                if ( level.batch && level.visible ) level.batch->drawInstanced( level.visible );
+            }
         }
     }
 }
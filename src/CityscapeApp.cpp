@@ -6,6 +6,7 @@
 #include "cinder/GeomIo.h"
 
 #include "CityData.h"
+#include "GpuResources.h"
 
 #include "Mode.h"
 #include "CityMode.h"
@@ -21,6 +22,7 @@ using namespace std;
 class CityscapeApp : public App {
   public:
     void setup();
+    void cleanup();
     void setupModeParams( ModeRef mode );
     void buildBackground();
 
@@ -81,6 +83,13 @@ void CityscapeApp::setup()
     mCurrentSeconds = getElapsedSeconds();
 }
 
+void CityscapeApp::cleanup()
+{
+    // Let go of the GL objects while there's still a context.
+    mModeRef.reset();
+    GpuResources::shared().clear();
+}
+
 void CityscapeApp::setupModeParams( ModeRef newMode )
 {
     mParams->clear();
@@ -14,9 +14,34 @@
 #include <CGAL/create_offset_polygons_from_polygon_with_holes_2.h>
 #include "GeometryHelpers.h"
 
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
 
 using namespace ci;
 
+struct FlatShape::Cache {
+    std::mutex  mutex;
+
+    bool        triedSkeleton = false;
+    SsPtr       skeleton;
+
+    std::map<float, std::vector<FlatShape>> contracted;
+
+    std::unique_ptr<Arrangement_2>          arrangement;
+
+    std::unique_ptr<std::vector<seg2>>      edges;
+
+    std::unique_ptr<CGAL::Polygon_with_holes_2<ExactK>>     exactPolygon;
+    std::unique_ptr<CGAL::Polygon_with_holes_2<InexactK>>   inexactPolygon;
+};
+
+// Only a handful of setbacks get used on any one shape, this just keeps
+// something like an animated offset from piling them up.
+const size_t kMaxContractions = 8;
+
 void FlatShape::fixUp()
 {
     // Look for the same point repeated...
@@ -44,18 +69,55 @@ void FlatShape::fixUp()
     for ( auto &hole : mHoles ) {
         if ( hole.isCounterclockwise() ) hole.reverse();
     }
+
+    mBounds = mOutline.size() ? Rectf( mOutline.getPoints() ) : Rectf( 0, 0, 0, 0 );
+    mCache = std::make_shared<Cache>();
 }
 
-std::vector<seg2> FlatShape::edges() const
+const std::vector<seg2>& FlatShape::edges() const
 {
-    std::vector<seg2> result;
-    auto inserter = std::back_inserter( result );
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( mCache->edges ) return *mCache->edges;
 
-    contiguousSeg2sFrom( outline(), inserter );
-    for ( auto &hole : holes() ) {
+    mCache->edges.reset( new std::vector<seg2>() );
+    auto inserter = std::back_inserter( *mCache->edges );
+    contiguousSeg2sFrom( mOutline, inserter );
+    for ( auto &hole : mHoles ) {
         contiguousSeg2sFrom( hole, inserter );
     }
-    return result;
+    return *mCache->edges;
+}
+
+template<>
+const CGAL::Polygon_with_holes_2<ExactK>& FlatShape::polygonWithHoles<ExactK>() const
+{
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( !mCache->exactPolygon ) {
+        mCache->exactPolygon.reset( new CGAL::Polygon_with_holes_2<ExactK>( polygonFrom<ExactK>( mOutline, mHoles ) ) );
+    }
+    return *mCache->exactPolygon;
+}
+
+template<>
+const CGAL::Polygon_with_holes_2<InexactK>& FlatShape::polygonWithHoles<InexactK>() const
+{
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( !mCache->inexactPolygon ) {
+        mCache->inexactPolygon.reset( new CGAL::Polygon_with_holes_2<InexactK>( polygonFrom<InexactK>( mOutline, mHoles ) ) );
+    }
+    return *mCache->inexactPolygon;
+}
+
+template<>
+const CGAL::Polygon_2<ExactK>& FlatShape::polygon<ExactK>() const
+{
+    return polygonWithHoles<ExactK>().outer_boundary();
+}
+
+template<>
+const CGAL::Polygon_2<InexactK>& FlatShape::polygon<InexactK>() const
+{
+    return polygonWithHoles<InexactK>().outer_boundary();
 }
 
 vec2 FlatShape::centroid() const
@@ -63,19 +125,53 @@ vec2 FlatShape::centroid() const
     return mOutline.calcCentroid();
 }
 
-vec2 FlatShape::randomPoint() const
+vec2 FlatShape::randomPoint( Rand &rand ) const
 {
     Rectf bounds = boundingBox();
     vec2 point;
     do {
-        point = vec2( randFloat( bounds.x1, bounds.x2 ), randFloat( bounds.y1, bounds.y2 ) );
+        point = vec2( rand.nextFloat( bounds.x1, bounds.x2 ), rand.nextFloat( bounds.y1, bounds.y2 ) );
     } while ( ! mOutline.contains( point ) );
     return point;
 }
 
+uint32_t FlatShape::hash() const
+{
+    // FNV-1a over the bits of every coordinate.
+    uint32_t result = 2166136261u;
+    auto add = [&result]( const PolyLine2f &line ) {
+        for ( const vec2 &p : line ) {
+            for ( float f : { p.x, p.y } ) {
+                uint32_t bits;
+                std::memcpy( &bits, &f, sizeof( bits ) );
+                for ( int shift = 0; shift < 32; shift += 8 ) {
+                    result ^= ( bits >> shift ) & 0xff;
+                    result *= 16777619u;
+                }
+            }
+        }
+    };
+    add( mOutline );
+    for ( const auto &hole : mHoles ) {
+        add( hole );
+    }
+    return result;
+}
+
+bool FlatShape::operator==( const FlatShape &other ) const
+{
+    if ( mOutline.getPoints() != other.mOutline.getPoints() ) return false;
+    if ( mHoles.size() != other.mHoles.size() ) return false;
+    for ( size_t i = 0; i < mHoles.size(); ++i ) {
+        if ( mHoles[i].getPoints() != other.mHoles[i].getPoints() ) return false;
+    }
+    return true;
+}
+
 bool FlatShape::contains( const ci::vec2 point ) const
 {
-    if ( !mOutline.contains( point ) ) {
+    // Cheap test first, most points we're asked about are nowhere near.
+    if ( !mBounds.contains( point ) || !mOutline.contains( point ) ) {
         return false;
     }
 
@@ -109,8 +205,12 @@ float FlatShape::calcArea() const
     return area;
 }
 
-Arrangement_2 FlatShape::arrangement() const {
-    Arrangement_2 arr;
+const Arrangement_2& FlatShape::arrangement() const {
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( mCache->arrangement ) return *mCache->arrangement;
+
+    mCache->arrangement.reset( new Arrangement_2() );
+    Arrangement_2 &arr = *mCache->arrangement;
 
     OutlineObserver outObs( arr );
     std::list<Segment_2> outlineSegments;
@@ -193,11 +293,38 @@ std::vector<FlatShape> FlatShape::contract( float offset ) const
         return std::vector<FlatShape>();
     }
 
-    PolyWithHoles input = polygonWithHoles<InexactK>();
-    std::vector<PolyPtr> outline = CGAL::create_interior_skeleton_and_offset_polygons_with_holes_2( offset, input );
+    {
+        std::lock_guard<std::mutex> lock( mCache->mutex );
+        auto found = mCache->contracted.find( offset );
+        if ( found != mCache->contracted.end() ) return found->second;
+    }
+
+    // Building the skeleton is the slow part, once we have it each offset is
+    // quick to read off it.
     std::vector<FlatShape> results;
-    for ( const auto &p : outline ) {
-        results.push_back( FlatShape( *p ) );
+    if ( SsPtr skel = skeleton() ) {
+        std::vector<PolygonPtr> offsets = CGAL::create_offset_polygons_2<CGAL::Polygon_2<InexactK>>( offset, *skel );
+        for ( const PolyPtr &p : CGAL::arrange_offset_polygons_2( offsets ) ) {
+            results.push_back( FlatShape( *p ) );
+        }
+    }
+
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( mCache->contracted.size() >= kMaxContractions ) {
+        mCache->contracted.clear();
     }
+    mCache->contracted[offset] = results;
     return results;
 }
+
+SsPtr FlatShape::skeleton() const
+{
+    const auto &input = polygonWithHoles<InexactK>();
+
+    std::lock_guard<std::mutex> lock( mCache->mutex );
+    if ( !mCache->triedSkeleton ) {
+        mCache->skeleton = CGAL::create_interior_straight_skeleton_2( input );
+        mCache->triedSkeleton = true;
+    }
+    return mCache->skeleton;
+}
@@ -1,5 +1,7 @@
 #include "GeometryHelpers.h"
 
+#include <algorithm>
+#include <cmath>
 #include <set>
 #include <limits>
 using std::numeric_limits;
@@ -106,6 +108,64 @@ seg2 oobDivider( const ci::PolyLine2f &outline, float fraction )
     return oobDivider( bounds, rotate, fraction );
 }
 
+PolyLine2f canonicalOutline( const PolyLine2f &outline, vec2 &origin, float &rotation )
+{
+    std::vector<vec2> points = outline.getPoints();
+    const bool repeatsFirst = points.size() > 1 && points.front() == points.back();
+    if ( repeatsFirst ) points.pop_back();
+
+    origin = outline.calcCentroid();
+    rotation = 0;
+    if ( points.size() < 2 ) return outline;
+
+    // Ties are only ties up to floating point noise, anything closer than
+    // this counts as the same so copies don't break them differently.
+    const float noise = 0.001f;
+    auto lexicographic = [&]( const vec2 &a, const vec2 &b ) {
+        if ( std::abs( a.x - b.x ) > noise ) return a.x < b.x;
+        return a.y < b.y - noise;
+    };
+
+    // Rectangles and other regular shapes have several edges that could be
+    // the longest. Try each and keep whichever gives the lowest points so
+    // every copy makes the same choice.
+    std::vector<float> lengths = distanceBetweenPointsIn( PolyLine2f( points, true ) );
+    float longest = *std::max_element( lengths.begin(), lengths.end() );
+    std::vector<vec2> best;
+    for ( size_t start = 0; start < points.size(); ++start ) {
+        if ( lengths[start] < longest * 0.999f ) continue;
+
+        vec2 edge = points[( start + 1 ) % points.size()] - points[start];
+        float angle = atan2( edge.y, edge.x );
+        mat3 matrix = rotate( mat3(), -angle );
+
+        std::vector<vec2> candidate;
+        candidate.reserve( points.size() );
+        for ( size_t i = 0; i < points.size(); ++i ) {
+            candidate.push_back( vec2( matrix * vec3( points[( start + i ) % points.size()] - origin, 1 ) ) );
+        }
+
+        if ( best.empty() || std::lexicographical_compare( candidate.begin(), candidate.end(), best.begin(), best.end(), lexicographic ) ) {
+            best = candidate;
+            rotation = angle;
+        }
+    }
+
+    if ( repeatsFirst ) best.push_back( best.front() );
+    PolyLine2f result( best );
+    result.setClosed( outline.isClosed() );
+    return result;
+}
+
+bool outlinesMatch( const std::vector<vec2> &a, const std::vector<vec2> &b, float tolerance )
+{
+    if ( a.size() != b.size() ) return false;
+    for ( size_t i = 0; i < a.size(); ++i ) {
+        if ( glm::distance( a[i], b[i] ) > tolerance ) return false;
+    }
+    return true;
+}
+
 // Gives back pairs of points to divide the shape with lines of a given angle.
 std::vector<seg2> computeDividers( const std::vector<vec2> &outline, const float angle, const float width )
 {
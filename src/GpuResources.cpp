@@ -0,0 +1,213 @@
+//
+//  GpuResources.cpp
+//  Cityscape
+//
+//
+
+#include "GpuResources.h"
+#include "Resources.h"
+
+using namespace ci;
+
+ci::gl::BatchRef buildSky()
+{
+    std::vector<vec3> positions;
+    std::vector<Color> colors;
+    Color darkBlue = Color8u(108, 184, 251);
+    Color medBlue = Color8u(160, 212, 250);
+    Color lightBlue = Color8u(174, 214, 246);
+
+    positions.push_back( vec3( +0.5, -0.5, +0.0 ) );
+    positions.push_back( vec3( -0.5, -0.5, +0.0 ) );
+    colors.push_back( darkBlue );
+    colors.push_back( darkBlue );
+    positions.push_back( vec3( +0.5, -0.2, +0.0 ) );
+    positions.push_back( vec3( -0.5, -0.2, +0.0 ) );
+    colors.push_back( medBlue );
+    colors.push_back( medBlue );
+    positions.push_back( vec3( +0.5, +0.2, +0.0 ) );
+    positions.push_back( vec3( -0.5, +0.2, +0.0 ) );
+    colors.push_back( medBlue );
+    colors.push_back( medBlue );
+    positions.push_back( vec3( +0.5, +0.5, +0.0 ) );
+    positions.push_back( vec3( -0.5, +0.5, +0.0 ) );
+    colors.push_back( lightBlue );
+    colors.push_back( lightBlue );
+
+    std::vector<gl::VboMesh::Layout> bufferLayout = {
+        gl::VboMesh::Layout().usage( GL_STATIC_DRAW ).attrib( geom::Attrib::POSITION, 3 ),
+        gl::VboMesh::Layout().usage( GL_STATIC_DRAW ).attrib( geom::Attrib::COLOR, 3 ),
+    };
+    gl::VboMeshRef mesh = gl::VboMesh::create( positions.size(), GL_TRIANGLE_STRIP, bufferLayout );
+    mesh->bufferAttrib( geom::Attrib::POSITION, positions );
+    mesh->bufferAttrib( geom::Attrib::COLOR, colors );
+
+    gl::GlslProgRef colorShader = gl::getStockShader( gl::ShaderDef().color() );
+
+    return gl::Batch::create( mesh, colorShader );
+}
+
+GpuResources& GpuResources::shared()
+{
+    static GpuResources resources;
+    return resources;
+}
+
+gl::GlslProgRef GpuResources::colorShader()
+{
+    // Cinder already keeps these around.
+    return gl::getStockShader( gl::ShaderDef().color() );
+}
+
+gl::GlslProgRef loadInstancedShader( const DataSourceRef &vertex, const DataSourceRef &fragment, bool fullMatrices )
+{
+    gl::GlslProg::Format format = gl::GlslProg::Format().vertex( vertex ).fragment( fragment );
+    if ( fullMatrices ) format.define( "FULL_MATRICES" );
+    return gl::GlslProg::create( format );
+}
+
+gl::GlslProgRef GpuResources::buildingShader( bool fullMatrices )
+{
+    gl::GlslProgRef &shader = mBuildingShaders[fullMatrices];
+    if ( !shader ) {
+        shader = loadInstancedShader( app::loadResource( RES_BUILDING_VERT ), app::loadResource( RES_BUILDING_FRAG ), fullMatrices );
+        float hue = 0.1;
+        shader->uniform( "darkColor",   Color( CM_HSV, hue, 0.60, 0.25 ) );
+        shader->uniform( "mediumColor", Color( CM_HSV, hue, 0.55, 0.66 ) );
+        shader->uniform( "lightColor",  Color( CM_HSV, hue, 0.15, 1.00 ) );
+    }
+    return shader;
+}
+
+gl::GlslProgRef GpuResources::treeShader( bool fullMatrices )
+{
+    gl::GlslProgRef &shader = mTreeShaders[fullMatrices];
+    if ( !shader ) {
+        shader = loadInstancedShader( app::loadResource( RES_TREE_VERT ), app::loadResource( RES_TREE_FRAG ), fullMatrices );
+    }
+    return shader;
+}
+
+gl::BatchRef GpuResources::sky()
+{
+    if ( !mSky ) mSky = buildSky();
+    return mSky;
+}
+
+GpuResources::Uploaded& GpuResources::uploadedFor( const SceneryRef &scenery )
+{
+    Uploaded &uploaded = mMeshes[scenery.get()];
+    if ( uploaded.scenery.expired() ) {
+        forget( uploaded );
+        uploaded = Uploaded();
+        uploaded.scenery = scenery;
+    }
+    return uploaded;
+}
+
+void GpuResources::forget( const Uploaded &uploaded )
+{
+    for ( const auto &packed : uploaded.packed ) {
+        mDeadIndices += packed.indexCount;
+    }
+}
+
+gl::VboMeshRef GpuResources::mesh( const SceneryRef &scenery, size_t level )
+{
+    Uploaded &uploaded = uploadedFor( scenery );
+    if ( uploaded.levels.empty() ) {
+        for ( size_t i = 0; i < scenery->levelsOfDetail(); ++i ) {
+            uploaded.levels.push_back( gl::VboMesh::create( scenery->geometry( i ) ) );
+        }
+    }
+
+    // The uploaded mesh is never drawn itself, it's only there to hand out
+    // its buffers.
+    const gl::VboMeshRef &source = uploaded.levels[ std::min( level, uploaded.levels.size() - 1 ) ];
+    return gl::VboMesh::create( source->getNumVertices(), source->getGlPrimitive(), source->getVertexArrayLayoutVbos(),
+        source->getNumIndices(), source->getIndexDataType(), source->getIndexVbo() );
+}
+
+GpuResources::PackedMesh GpuResources::packedMesh( const SceneryRef &scenery, size_t level )
+{
+    Uploaded &uploaded = uploadedFor( scenery );
+    if ( uploaded.packed.empty() ) {
+        for ( size_t i = 0; i < scenery->levelsOfDetail(); ++i ) {
+            TriMesh mesh( scenery->geometry( i ), TriMesh::Format().positions( 3 ) );
+            PackedMesh packed;
+            packed.firstIndex = mPackedIndices.size();
+            packed.indexCount = mesh.getNumIndices();
+            packed.baseVertex = mPackedPositions.size();
+            const vec3 *positions = mesh.getPositions<3>();
+            mPackedPositions.insert( mPackedPositions.end(), positions, positions + mesh.getNumVertices() );
+            mPackedIndices.insert( mPackedIndices.end(), mesh.getIndices().begin(), mesh.getIndices().end() );
+            uploaded.packed.push_back( packed );
+        }
+        uploadPacked();
+    }
+    return uploaded.packed[ std::min( level, uploaded.packed.size() - 1 ) ];
+}
+
+void GpuResources::uploadPacked()
+{
+    // Doubles as it grows, anything already drawing from the old buffers
+    // keeps them.
+    auto upload = []( gl::VboRef &vbo, GLenum target, const void *data, size_t size, size_t uploaded ) {
+        if ( !vbo || vbo->getSize() < size ) {
+            vbo = gl::Vbo::create( target, size * 2, nullptr, GL_STATIC_DRAW );
+            vbo->bufferSubData( 0, size, data );
+        } else if ( size > uploaded ) {
+            vbo->bufferSubData( uploaded, size - uploaded, static_cast<const char*>( data ) + uploaded );
+        }
+    };
+    upload( mPackedPositionVbo, GL_ARRAY_BUFFER, mPackedPositions.data(), mPackedPositions.size() * sizeof( vec3 ), mUploadedPositions * sizeof( vec3 ) );
+    upload( mPackedIndexVbo, GL_ELEMENT_ARRAY_BUFFER, mPackedIndices.data(), mPackedIndices.size() * sizeof( uint32_t ), mUploadedIndices * sizeof( uint32_t ) );
+    mUploadedPositions = mPackedPositions.size();
+    mUploadedIndices = mPackedIndices.size();
+}
+
+void GpuResources::purge()
+{
+    for ( auto it = mMeshes.begin(); it != mMeshes.end(); ) {
+        if ( it->second.scenery.expired() ) {
+            forget( it->second );
+            it = mMeshes.erase( it );
+        } else {
+            ++it;
+        }
+    }
+
+    // Start the packing over, whatever's still wanted gets packed again as
+    // it's asked for.
+    if ( mDeadIndices > mPackedIndices.size() / 2 ) {
+        for ( auto &entry : mMeshes ) entry.second.packed.clear();
+        mPackedPositions.clear();
+        mPackedIndices.clear();
+        mDeadIndices = mUploadedPositions = mUploadedIndices = 0;
+        mPackedPositionVbo.reset();
+        mPackedIndexVbo.reset();
+    }
+}
+
+bool GpuResources::holds( const std::weak_ptr<const Scenery> &scenery ) const
+{
+    // Compared by owner so it still works once they've expired.
+    for ( const auto &entry : mMeshes ) {
+        const auto &held = entry.second.scenery;
+        if ( !held.owner_before( scenery ) && !scenery.owner_before( held ) ) return true;
+    }
+    return false;
+}
+
+void GpuResources::clear()
+{
+    for ( auto &shader : mBuildingShaders ) shader.reset();
+    for ( auto &shader : mTreeShaders ) shader.reset();
+    mSky.reset();
+    mMeshes.clear();
+    mPackedPositions.clear();
+    mPackedIndices.clear();
+    mDeadIndices = mUploadedPositions = mUploadedIndices = 0;
+    mPackedPositionVbo.reset();
+    mPackedIndexVbo.reset();
+}
@@ -0,0 +1,81 @@
+//
+//  InstanceData.cpp
+//  Cityscape
+//
+//
+
+#include "InstanceData.h"
+
+#include <glm/gtc/packing.hpp>
+
+#include <cmath>
+
+using namespace ci;
+
+static_assert( sizeof( InstanceData ) == 24, "The shaders expect instances to be tightly packed" );
+
+// Halves keep 11 bits of precision between these, closer to zero they start
+// losing it and past the top they're infinite.
+const float HALF_MIN = 6.103515625e-05f;
+const float HALF_MAX = 65504.0f;
+
+boost::optional<InstanceData> InstanceData::pack( const mat4 &m, const ColorA &color )
+{
+    // How far off square the axes can be, relative to their length, before
+    // it's more than rounding.
+    const float tolerance = 1e-4;
+
+    // No projection.
+    if ( m[0][3] != 0 || m[1][3] != 0 || m[2][3] != 0 || m[3][3] != 1 ) return boost::none;
+
+    const vec2 across( m[0] ), along( m[1] );
+    const float scaleX = glm::length( across );
+    float scaleY = glm::length( along );
+    const float scaleZ = m[2][2];
+
+    // The x and y axes have to stay flat and square to each other, and z
+    // has to stay upright.
+    if ( std::abs( m[0][2] ) > tolerance * scaleX || std::abs( m[1][2] ) > tolerance * scaleY ) return boost::none;
+    if ( std::abs( m[2][0] ) > tolerance * std::abs( scaleZ ) || std::abs( m[2][1] ) > tolerance * std::abs( scaleZ ) ) return boost::none;
+    if ( std::abs( glm::dot( across, along ) ) > tolerance * scaleX * scaleY ) return boost::none;
+    if ( across.x * along.y - across.y * along.x < 0 ) scaleY = -scaleY;
+
+    // x carries the turn so it can't be flattened away, y and z can.
+    auto fits = []( float scale, bool zeroOk ) {
+        float size = std::abs( scale );
+        return ( zeroOk && size == 0 ) || ( size >= HALF_MIN && size <= HALF_MAX );
+    };
+    if ( !fits( scaleX, false ) || !fits( scaleY, true ) || !fits( scaleZ, true ) ) return boost::none;
+
+    auto channel = []( float value ) {
+        return uint32_t( std::round( glm::clamp( value, 0.0f, 1.0f ) * 255 ) );
+    };
+
+    InstanceData result;
+    result.position = vec3( m[3] );
+    result.axes[0] = glm::packHalf1x16( across.x );
+    result.axes[1] = glm::packHalf1x16( across.y );
+    result.axes[2] = glm::packHalf1x16( scaleY );
+    result.axes[3] = glm::packHalf1x16( scaleZ );
+    result.color = channel( color.r ) | channel( color.g ) << 8 | channel( color.b ) << 16 | channel( color.a ) << 24;
+    return result;
+}
+
+mat4 InstanceData::matrix() const
+{
+    // Same as the shaders.
+    const vec2 across( glm::unpackHalf1x16( axes[0] ), glm::unpackHalf1x16( axes[1] ) );
+    const vec2 along = vec2( -across.y, across.x ) * ( glm::unpackHalf1x16( axes[2] ) / glm::length( across ) );
+
+    mat4 result;
+    result[0] = vec4( across, 0, 0 );
+    result[1] = vec4( along, 0, 0 );
+    result[2] = vec4( 0, 0, glm::unpackHalf1x16( axes[3] ), 0 );
+    result[3] = vec4( position, 1 );
+    return result;
+}
+
+vec4 InstanceData::rgba() const
+{
+    return vec4( color & 0xFF, color >> 8 & 0xFF, color >> 16 & 0xFF, color >> 24 ) / 255.0f;
+}
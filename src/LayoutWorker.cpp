@@ -0,0 +1,121 @@
+//
+//  LayoutWorker.cpp
+//  Cityscape
+//
+//
+
+#include "LayoutWorker.h"
+#include "CityPipeline.h"
+
+namespace Cityscape {
+
+LayoutWorker::LayoutWorker()
+{
+    mThread = std::thread( &LayoutWorker::loop, this );
+}
+
+LayoutWorker::~LayoutWorker()
+{
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mStopping = true;
+        // Bump the generation so a layout in progress bails at the next stage.
+        ++mGeneration;
+    }
+    mWake.notify_all();
+    mThread.join();
+}
+
+void LayoutWorker::request( const CityModel &model )
+{
+    CityModel inputs = model;
+    inputs.streets.clear();
+    inputs.pavement.clear();
+    inputs.districts.clear();
+    // The UI edits zoning plans in place so the worker gets its own copies.
+    // They're only replaced when the settings change which saves work
+    // comparing them later. Copies of plans this request doesn't use are
+    // dropped.
+    std::map<ZoningPlanRef, ZoningPlanRef> copies;
+    for ( auto &plan : inputs.zoningPlans ) {
+        ZoningPlanRef &copy = copies[plan];
+        if ( !copy ) {
+            auto previous = mPlanCopies.find( plan );
+            if ( previous != mPlanCopies.end() ) copy = previous->second;
+        }
+        if ( !copy || *copy != *plan ) {
+            copy = std::make_shared<ZoningPlan>( *plan );
+        }
+        plan = copy;
+    }
+    mPlanCopies.swap( copies );
+
+    {
+        std::lock_guard<std::mutex> lock( mMutex );
+        mRequest = std::move( inputs );
+        mHasRequest = true;
+        ++mGeneration;
+    }
+    mWake.notify_all();
+}
+
+bool LayoutWorker::takeResult( CityModel &model )
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    if ( !mHasResult ) return false;
+
+    // Shared with the worker's copy, which only ever replaces pieces of the
+    // city, never changes the ones it hands out.
+    model.streets = mResult.streets;
+    model.pavement = mResult.pavement;
+    model.districts = mResult.districts;
+    mHasResult = false;
+    return true;
+}
+
+bool LayoutWorker::isBusy()
+{
+    std::lock_guard<std::mutex> lock( mMutex );
+    return mHasRequest || mWorking || mHasResult;
+}
+
+void LayoutWorker::loop()
+{
+    std::unique_lock<std::mutex> lock( mMutex );
+    while ( true ) {
+        mWake.wait( lock, [this] { return mStopping || mHasRequest; } );
+        if ( mStopping ) return;
+
+        // Start from the last finished layout so the pipeline can tell what
+        // still needs doing.
+        CityModel city = std::move( mRequest );
+        city.streets = mPrevious.streets;
+        city.pavement = mPrevious.pavement;
+        city.districts = mPrevious.districts;
+        city.highwaysKey = mPrevious.highwaysKey;
+        mHasRequest = false;
+        mWorking = true;
+        const uint64_t generation = mGeneration;
+        lock.unlock();
+
+        bool cancelled = false;
+        for ( const auto &stage : pipelineStages() ) {
+            stage.run( city );
+
+            lock.lock();
+            cancelled = generation != mGeneration;
+            lock.unlock();
+            if ( cancelled ) break;
+        }
+
+        lock.lock();
+        mWorking = false;
+        if ( !cancelled ) {
+            mPrevious = city;
+            mResult = std::move( city );
+            mHasResult = true;
+        }
+    }
+}
+
+} // Cityscape namespace
@@ -13,6 +13,7 @@
 #include "cinder/Rand.h"
 #include "GeometryHelpers.h" // used to contract lot size to avoid overflow
 #include "Scenery.h"
+#include "BuildingPlanCache.h"
 
 using namespace ci;
 
@@ -33,7 +34,7 @@ seg2 longestStreetSide( const LotRef &lot )
 }
 
 seg2 longestEdgeIn( const FlatShape &shape ) {
-    std::vector<seg2> edges = shape.edges();
+    const std::vector<seg2> &edges = shape.edges();
 
     if ( edges.size() == 0 ) {
         return seg2( vec2( 0 ), vec2( 0 ) );
@@ -93,20 +94,20 @@ ConeTreeRef coneTree = ConeTree::create();
 SphereTreeRef sphereTree = SphereTree::create();
 RowCropRef crop = RowCrop::create();
 
-void ParkDeveloper::buildIn( LotRef &lot ) const
+void ParkDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
     // Shrink the area so trees don't hang out of the sides
     for ( const FlatShape &shape : lot->shape->contract( 5 ) ) {
         float area = shape.area();
-        float treeCoverage = randFloat( 0.25, 0.75 );
+        float treeCoverage = rand.nextFloat( 0.25, 0.75 );
         float totalTreeArea = 0.0;
 
         while ( totalTreeArea / area < treeCoverage ) {
             // Bigger areas should get bigger trees (speeds up the generation).
             // TODO: come up with a better formula for this
-            float diameter = area < 10000 ? randFloat( 4, 12 ) : randFloat( 10, 20 );
+            float diameter = area < 10000 ? rand.nextFloat( 4, 12 ) : rand.nextFloat( 10, 20 );
 
-            lot->plants.push_back( sphereTree->instance( shape.randomPoint(), diameter ) );
+            lot->plants.add( sphereTree->instance( shape.randomPoint( rand ), diameter ) );
 
             // Treat it as a square for faster math and less dense coverage.
             totalTreeArea += diameter * diameter;
@@ -121,9 +122,8 @@ bool SingleFamilyHomeDeveloper::isValidFor( LotRef &lot ) const
     // TODO: should have a configurable minimum lot size.
     return mPlans.size() > 0 && lot->shape->area() > 100;
 }
-void SingleFamilyHomeDeveloper::buildIn( LotRef &lot ) const
+void SingleFamilyHomeDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
-    Rand r;
     for ( const FlatShape &shape : lot->shape->contract( 5 ) ) {
         auto maybeInstance = findPosition( lot, 3, [&]
             {
@@ -133,19 +133,19 @@ void SingleFamilyHomeDeveloper::buildIn( LotRef &lot ) const
                 float angle = angleToLongestStreet( lot, centroid );
 
                 // Pick a random plan
-                SceneryRef plan = mPlans[ r.nextUint( mPlans.size() ) ];
+                SceneryRef plan = mPlans[ rand.nextUint( mPlans.size() ) ];
                 return plan->instance( centroid, angle );
             }
         );
         if( maybeInstance ) {
-            lot->buildings.push_back( maybeInstance.value() );
+            lot->buildings.add( maybeInstance.value() );
 
             // TODO: the intersection check should take tree diameter into account
-            vec2 treeAt = lot->shape->randomPoint();
+            vec2 treeAt = lot->shape->randomPoint( rand );
             if (  ! maybeInstance->footprint().contains( treeAt ) ) {
-                float ratio = randFloat( 1, 3 );
-                float diameter = randFloat( 5, 10 );
-                lot->plants.push_back( coneTree->instance( treeAt, diameter, diameter * ratio ) );
+                float ratio = rand.nextFloat( 1, 3 );
+                float diameter = rand.nextFloat( 5, 10 );
+                lot->plants.add( coneTree->instance( treeAt, diameter, diameter * ratio ) );
             }
         }
     }
@@ -158,9 +158,8 @@ bool PickFromListDeveloper::isValidFor( LotRef &lot ) const
     // TODO: should have a configurable minimum lot size.
     return mPlans.size() > 0 && lot->shape->area() > 300;
 }
-void PickFromListDeveloper::buildIn( LotRef &lot ) const
+void PickFromListDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
-    Rand r;
     for ( const FlatShape &shape : lot->shape->contract( 5 ) ) {
         auto maybeInstance = findPosition( lot, 3, [&]
             {
@@ -170,12 +169,12 @@ void PickFromListDeveloper::buildIn( LotRef &lot ) const
                 float angle = angleToLongestStreet( lot, centroid );
 
                 // Pick a random plan
-                SceneryRef plan = mPlans[ r.nextUint( mPlans.size() ) ];
+                SceneryRef plan = mPlans[ rand.nextUint( mPlans.size() ) ];
                 return plan->instance( centroid, angle );
             }
         );
         if( maybeInstance ) {
-            lot->buildings.push_back( maybeInstance.value() );
+            lot->buildings.add( maybeInstance.value() );
         }
     }
 }
@@ -187,7 +186,7 @@ bool FullLotDeveloper::isValidFor( LotRef &lot ) const
     float area = lot->shape->area();
     return area > 100;
 }
-void FullLotDeveloper::buildIn( LotRef &lot ) const
+void FullLotDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
     // Vary the floors based on the area...
     // TODO: would be interesting to make taller buildings on smaller lots
@@ -196,13 +195,20 @@ void FullLotDeveloper::buildIn( LotRef &lot ) const
     lot->buildings.clear();
 
     if ( area > 100 ) {
-        int floors = 1 + (int) ( sqrt( area ) / 20 ) + ci::randInt( 6 );
-
-        // It's kind of odd that we're passing the coordinates in via the
-        // outline and having no instance offset. I guess it doesn't matter
-        // since we're not reusing the plan or rotating it.
-        SceneryRef plan = BuildingPlan::create( lot->shape->outline(), floors, mRoof );
-        lot->buildings.push_back( plan->instance( vec2( 0 ) ) );
+        int floors = 1 + (int) ( sqrt( area ) / 20 ) + rand.nextInt( 6 );
+
+        BuildingSettings settings;
+        settings.floors = floors;
+        settings.roofStyle = mRoof;
+
+        // Build the plan around the origin so lots that are just moved or
+        // turned copies of each other share it, then put it in place with
+        // the instance.
+        vec2 origin;
+        float rotation;
+        PolyLine2f footprint = canonicalOutline( lot->shape->outline(), origin, rotation );
+        SceneryRef plan = BuildingPlanCache::shared().plan( footprint, settings );
+        lot->buildings.add( plan->instance( origin, rotation ) );
     }
 }
 
@@ -213,7 +219,7 @@ bool SquareGridDeveloper::isValidFor( LotRef &lot ) const
     float area = lot->shape->area();
     return area > mRowSpacing * mStructureSpacing;
 }
-void SquareGridDeveloper::buildIn( LotRef &lot ) const
+void SquareGridDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
     float setback = math<float>::min( mRowSpacing, mStructureSpacing ) / 4;
 
@@ -227,7 +233,7 @@ void SquareGridDeveloper::buildIn( LotRef &lot ) const
             size_t count = length / mStructureSpacing;
             for ( size_t i = 0; i < count; ++i ) {
                 vec2 at = divider.first + unitVector * ( i + 0.5f );
-                lot->buildings.push_back( mScenery->instance( at ) );
+                lot->buildings.add( mScenery->instance( at ) );
             }
         }
     }
@@ -235,7 +241,7 @@ void SquareGridDeveloper::buildIn( LotRef &lot ) const
 
 // * * *
 
-void FarmOrchardDeveloper::buildIn( LotRef &lot ) const
+void FarmOrchardDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
     for ( const FlatShape &shape : lot->shape->contract( mDiameter / 2.0 ) ) {
         std::vector<seg2> dividers = shape.dividerSeg2s( mAngle, mTreeSpacing );
@@ -251,7 +257,7 @@ void FarmOrchardDeveloper::buildIn( LotRef &lot ) const
             size_t treeCount = length / mTreeSpacing;
             for ( size_t i = 1; i < treeCount; ++i ) {
                 vec2 at = divider.first + unitVector * ( i + ( even ? 0.0f : 0.5f ) );
-                lot->plants.push_back( sphereTree->instance( at + randVec2(), mDiameter + randFloat( 1.0 ) ) );
+                lot->plants.add( sphereTree->instance( at + rand.nextVec2(), mDiameter + rand.nextFloat( 1.0 ) ) );
             }
             even = !even;
         }
@@ -260,21 +266,21 @@ void FarmOrchardDeveloper::buildIn( LotRef &lot ) const
 
 // * * *
 
-void FarmFieldDeveloper::buildIn( LotRef &lot ) const
+void FarmFieldDeveloper::buildIn( LotRef &lot, ci::Rand &rand ) const
 {
     // TODO: would be nice if there was an easier way to add holes:
-    PolyLine2 outline = lot->shape->outline();
+    const PolyLine2 &outline = lot->shape->outline();
     PolyLine2fs holes = lot->shape->holes();
 
     if( mBuilding ) {
         boost::optional<Scenery::Instance> maybeInstance = findPosition( lot, 3, [&]
             {
-                vec2 houseAt = lot->shape->randomPoint();
+                vec2 houseAt = lot->shape->randomPoint( rand );
                 return mBuilding->instance( houseAt, angleToLongestStreet( lot, houseAt ) );
             }
         );
         if( maybeInstance ) {
-            lot->buildings.push_back( maybeInstance.value() );
+            lot->buildings.add( maybeInstance.value() );
             holes.push_back( maybeInstance->footprint().reversed() );
         }
     }
@@ -283,7 +289,7 @@ void FarmFieldDeveloper::buildIn( LotRef &lot ) const
     for( const FlatShape &shape : shapeWithBuilding.contract( mRowSpacing ) ) {
         float angle = angleOfLongestEdge( shape );
         for( const seg2 &divider : shape.dividerSeg2s( angle, mRowSpacing ) ) {
-            lot->plants.push_back( crop->instance( divider.first, divider.second, mRowWidth ) );
+            lot->plants.add( crop->instance( divider.first, divider.second, mRowWidth ) );
         }
     }
 }
@@ -9,13 +9,14 @@
 #include "LotFiller.h"
 #include "LotDeveloper.h"
 #include "FlatShape.h"
+#include "ParallelFor.h"
 #include "cinder/Rand.h"
 
 using namespace ci;
 
 namespace Cityscape {
 
-const LotDeveloperRef pickDeveloper( LotRef &lot, const ZoningPlanRef &zoning ) {
+const LotDeveloperRef pickDeveloper( LotRef &lot, const ZoningPlanRef &zoning, Rand &rand ) {
     std::vector<LotDeveloperRef> developerPool;
 
     // Figure out which developers are applicable then seed a pool...
@@ -27,23 +28,36 @@ const LotDeveloperRef pickDeveloper( LotRef &lot, const ZoningPlanRef &zoning )
     }
 
     if ( developerPool.size() ) {
-        return developerPool.at( randInt( static_cast<int32_t>( developerPool.size() ) ) );
+        return developerPool.at( rand.nextInt( static_cast<int32_t>( developerPool.size() ) ) );
     }
     return nullptr;
 }
 
 void fillLots( CityModel &city )
 {
+    // Only the lots that haven't been built up with the current settings.
+    std::vector<std::pair<ZoningPlanRef, LotRef>> lots;
     for ( const auto &district : city.districts ) {
-        ZoningPlanRef zoning = district->zoningPlan;
-
+        const uint64_t key = sceneryKeyFor( *district->zoningPlan, city.seed );
         for ( const auto &block : district->blocks ) {
             for ( auto &lot : block->lots ) {
-                LotDeveloperRef developer = pickDeveloper( lot, zoning );
-                if ( developer ) developer->buildIn( lot );
+                if ( lot->sceneryKey != key ) lots.push_back( { district->zoningPlan, lot } );
             }
         }
     }
+
+    parallelFor( lots.size(), [&]( size_t i ) {
+        LotRef &lot = lots[i].second;
+
+        // Seed from the lot's shape rather than its position in the list so
+        // the same city comes out with any number of threads.
+        Rand rand( seedFor( city.seed, lot->shape->hash() ) );
+        lot->buildings.clear();
+        lot->plants.clear();
+        LotDeveloperRef developer = pickDeveloper( lot, lots[i].first, rand );
+        if ( developer ) developer->buildIn( lot, rand );
+        lot->sceneryKey = sceneryKeyFor( *lots[i].first, city.seed );
+    } );
 }
 
 } // Cityscape namespace
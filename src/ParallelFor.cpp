@@ -0,0 +1,195 @@
+//
+//  ParallelFor.cpp
+//  Cityscape
+//
+//
+
+#include "ParallelFor.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Cityscape {
+
+namespace {
+
+struct Job {
+    Job( size_t count, const std::function<void(size_t)> &work ) : count( count ), work( work ), next( 0 ) {}
+
+    // Pull indices until they're all claimed.
+    void help()
+    {
+        for ( size_t i = next++; i < count; i = next++ ) {
+            try {
+                work( i );
+            }
+            catch ( ... ) {
+                std::lock_guard<std::mutex> lock( errorMutex );
+                if ( !error ) error = std::current_exception();
+                next = count;
+            }
+        }
+    }
+
+    const size_t                            count;
+    const std::function<void(size_t)>       &work;
+    std::atomic<size_t>                     next;
+    std::mutex                              errorMutex;
+    std::exception_ptr                      error;
+};
+
+thread_local bool tInsideJob = false;
+
+// Marks the current thread as busy with a job so nested calls don't wait on
+// the pool they're already part of.
+struct InsideJob {
+    InsideJob() : mWasInside( tInsideJob ) { tInsideJob = true; }
+    ~InsideJob() { tInsideJob = mWasInside; }
+
+    bool mWasInside;
+};
+
+class WorkerPool {
+  public:
+    static WorkerPool& shared()
+    {
+        static WorkerPool pool;
+        return pool;
+    }
+
+    WorkerPool()
+    {
+        unsigned cores = std::thread::hardware_concurrency();
+        resize( cores > 0 ? cores : 1 );
+    }
+
+    ~WorkerPool()
+    {
+        stop();
+    }
+
+    size_t size()
+    {
+        std::lock_guard<std::mutex> runLock( mRunMutex );
+        return mThreads.size() + 1;
+    }
+
+    void resize( size_t count )
+    {
+        std::lock_guard<std::mutex> runLock( mRunMutex );
+        stop();
+        mStopping = false;
+        for ( size_t i = 1; i < count; ++i ) {
+            mThreads.push_back( std::thread( &WorkerPool::loop, this ) );
+        }
+    }
+
+    void run( size_t count, const std::function<void(size_t)> &work )
+    {
+        if ( count == 0 ) return;
+
+        if ( count == 1 || tInsideJob ) {
+            for ( size_t i = 0; i < count; ++i ) work( i );
+            return;
+        }
+
+        // Only one job at a time, anyone else waits their turn.
+        std::lock_guard<std::mutex> runLock( mRunMutex );
+        if ( mThreads.empty() ) {
+            InsideJob inside;
+            for ( size_t i = 0; i < count; ++i ) work( i );
+            return;
+        }
+
+        auto job = std::make_shared<Job>( count, work );
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+            mJob = job;
+            ++mGeneration;
+        }
+        mWake.notify_all();
+
+        {
+            InsideJob inside;
+            job->help();
+        }
+
+        {
+            std::unique_lock<std::mutex> lock( mMutex );
+            mFinished.wait( lock, [this] { return mBusy == 0; } );
+            mJob.reset();
+        }
+
+        if ( job->error ) std::rethrow_exception( job->error );
+    }
+
+  private:
+    void loop()
+    {
+        tInsideJob = true;
+        uint64_t seen = 0;
+        std::unique_lock<std::mutex> lock( mMutex );
+        while ( true ) {
+            mWake.wait( lock, [&] { return mStopping || mGeneration != seen; } );
+            if ( mStopping ) return;
+            seen = mGeneration;
+
+            // Woke up too late and the caller already wrapped it up.
+            std::shared_ptr<Job> job = mJob;
+            if ( !job ) continue;
+
+            ++mBusy;
+            lock.unlock();
+            job->help();
+            lock.lock();
+            if ( --mBusy == 0 ) mFinished.notify_all();
+        }
+    }
+
+    // Caller must hold mRunMutex.
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock( mMutex );
+            mStopping = true;
+        }
+        mWake.notify_all();
+        for ( auto &thread : mThreads ) thread.join();
+        mThreads.clear();
+    }
+
+    std::mutex                  mRunMutex;
+    std::vector<std::thread>    mThreads;
+
+    std::mutex                  mMutex;
+    std::condition_variable     mWake;
+    std::condition_variable     mFinished;
+    std::shared_ptr<Job>        mJob;
+    uint64_t                    mGeneration = 0;
+    size_t                      mBusy = 0;
+    bool                        mStopping = false;
+};
+
+} // anonymous namespace
+
+void setWorkerThreadCount( size_t count )
+{
+    WorkerPool::shared().resize( count > 0 ? count : 1 );
+}
+
+size_t workerThreadCount()
+{
+    return WorkerPool::shared().size();
+}
+
+void parallelFor( size_t count, const std::function<void(size_t)> &work )
+{
+    WorkerPool::shared().run( count, work );
+}
+
+} // Cityscape namespace
@@ -10,8 +10,12 @@
 #include "GeometryHelpers.h"
 #include "FlatShape.h"
 #include "CgalPolygon.h"
+#include "ParallelFor.h"
 #include <CGAL/Polygon_set_2.h>
 
+#include <algorithm>
+#include <unordered_map>
+
 using namespace std;
 using namespace ci;
 
@@ -32,12 +36,94 @@ CGAL::Polygon_2<ExactK> roadOutline( const ci::vec2 &a, const ci::vec2 &b, uint8
     return results;
 };
 
-// in Highways
-// out Districts and paved FlatShape
-void buildHighwaysAndDistricts( CityModel &city )
+// in PolyLines
+// out Highways (one per segment)
+void setHighways( CityModel &city, const std::vector<ci::PolyLine2f> &lines )
+{
+    city.highways.clear();
+    for ( const auto &line : lines ) {
+        // Translate from PolyLines into Highways... would be nice if highways
+        // weren't just simple segments :/
+        pointsInPairs<vec2>( line,
+            [&](const vec2 &a, const vec2 &b) {
+                city.highways.push_back( Highway::create( a, b ) );
+            }
+        );
+    }
+}
+
+// Copy a lot's outline and sides but none of its scenery.
+LotRef bareCopyOf( const LotRef &old )
+{
+    LotRef lot = Lot::create( old->shape );
+    lot->color = old->color;
+    lot->streetFacingSides = old->streetFacingSides;
+    return lot;
+}
+
+// Keep whatever the old district has that's still good under plan. The old
+// one may still be on screen so anything that needs rebuilding is copied
+// rather than cleared out.
+DistrictRef carryOver( const DistrictRef &old, const ZoningPlanRef &plan, uint32_t seed )
+{
+    const uint64_t streetsKey = streetsKeyFor( *plan );
+    const uint64_t lotsKey = lotsKeyFor( *plan, seed );
+    const uint64_t sceneryKey = sceneryKeyFor( *plan, seed );
+
+    auto blockIsCurrent = [&]( const BlockRef &block ) {
+        return block->lotsKey == lotsKey && std::all_of( block->lots.begin(), block->lots.end(), [&]( const LotRef &lot ) {
+            return lot->sceneryKey == sceneryKey;
+        } );
+    };
+
+    if ( old->streetsKey == streetsKey && std::all_of( old->blocks.begin(), old->blocks.end(), blockIsCurrent ) ) {
+        return old;
+    }
+
+    DistrictRef district = District::create( old->shape, plan );
+    district->color = old->color;
+    if ( old->streetsKey != streetsKey ) return district;
+
+    district->pavement = old->pavement;
+    district->streetsKey = old->streetsKey;
+    for ( const auto &oldBlock : old->blocks ) {
+        if ( blockIsCurrent( oldBlock ) ) {
+            district->blocks.push_back( oldBlock );
+            continue;
+        }
+
+        BlockRef block = Block::create( oldBlock->shape );
+        block->color = oldBlock->color;
+        if ( oldBlock->lotsKey == lotsKey ) {
+            block->lotsKey = oldBlock->lotsKey;
+            for ( const auto &lot : oldBlock->lots ) {
+                block->lots.push_back( lot->sceneryKey == sceneryKey ? lot : bareCopyOf( lot ) );
+            }
+        }
+        district->blocks.push_back( block );
+    }
+    return district;
+}
+
+// Hand back what can be kept of the last layout's district with this shape,
+// if there was one. Otherwise a new one.
+DistrictRef districtFor( std::unordered_multimap<uint32_t, DistrictRef> &previous, const FlatShapeRef &shape, const ZoningPlanRef &plan, uint32_t seed )
+{
+    auto range = previous.equal_range( shape->hash() );
+    for ( auto it = range.first; it != range.second; ++it ) {
+        DistrictRef district = it->second;
+        if ( *district->shape == *shape ) {
+            previous.erase( it );
+            return carryOver( district, plan, seed );
+        }
+    }
+    return District::create( shape, plan );
+}
+
+// Break the board up into the areas between highways.
+std::vector<FlatShapeRef> buildHighways( CityModel &city )
 {
     city.pavement.clear();
-    city.districts.clear();
 
     // Collect all the road shapes so we can insert them at once.
     vector<CGAL::Polygon_2<ExactK>> roads;
@@ -57,14 +143,12 @@ void buildHighwaysAndDistricts( CityModel &city )
         city.pavement.push_back( FlatShape::create( s ) );
     }
 
-    size_t plan = 0;
+    std::vector<FlatShapeRef> districtShapes;
 
     // Find the unpaved chunks to break up with streets
     unpaved.complement( paved );
     unpaved.polygons_with_holes( back_inserter( unpavedShapes ) );
     for ( auto &s : unpavedShapes ) {
-        FlatShapeRef fs;
-
         if ( s.is_unbounded() ) {
             CGAL::Polygon_2<ExactK> board;
             board.push_back( ExactK::Point_2( -600, -600 ) );
@@ -75,71 +159,144 @@ void buildHighwaysAndDistricts( CityModel &city )
             for ( auto hole = s.holes_begin(); hole != s.holes_end(); ++hole ) {
                 outer.add_hole( *hole );
             }
-            fs = FlatShape::create( outer );
+            districtShapes.push_back( FlatShape::create( outer ) );
         } else {
-            fs = FlatShape::create( s );
+            districtShapes.push_back( FlatShape::create( s ) );
         }
+    }
+
+    return districtShapes;
+}
+
+// in Highways
+// out Districts and paved FlatShape
+void buildHighwaysAndDistricts( CityModel &city )
+{
+    std::vector<FlatShapeRef> districtShapes;
 
-        city.districts.push_back( District::create( fs, city.zoningPlans[plan] ) );
+    const uint64_t highwaysKey = highwaysKeyFor( city );
+    if ( highwaysKey == city.highwaysKey ) {
+        // Same roads as last time so the same district outlines, the zoning
+        // might be different though.
+        for ( const auto &district : city.districts ) {
+            districtShapes.push_back( district->shape );
+        }
+    } else {
+        districtShapes = buildHighways( city );
+        city.highwaysKey = highwaysKey;
+    }
+
+    std::unordered_multimap<uint32_t, DistrictRef> previous;
+    for ( auto &district : city.districts ) {
+        previous.insert( { district->shape->hash(), district } );
+    }
+    city.districts.clear();
+
+    size_t plan = 0;
+    for ( const auto &shape : districtShapes ) {
+        city.districts.push_back( districtFor( previous, shape, city.zoningPlans[plan], city.seed ) );
         if ( ++plan >= city.zoningPlans.size() ) { plan = 0; }
     }
 }
 
-// in Districts
-// out Streets, Blocks and paved FlatShape
-void buildStreetsAndBlocks( CityModel &city )
+// What a district's street grid leaves behind: the street surfaces and the
+// blocks between them.
+struct StreetGrid {
+    // Holds the pavement, block shapes and blocks built for the district so
+    // they sit together and go away together.
+    std::shared_ptr<Arena>      arena;
+    std::vector<FlatShapeRef>   pavement;
+    std::vector<FlatShapeRef>   blocks;
+};
+
+StreetGrid buildStreetGrid( const DistrictRef &district )
 {
-    for ( auto &district : city.districts ) {
+    StreetGrid result;
+    result.arena = Arena::create();
+    Arena::Scope scope( result.arena );
 
-        district->blocks.clear();
+    ZoningPlanRef plan = district->zoningPlan;
 
-        ZoningPlanRef plan = district->zoningPlan;
+    if ( plan->district.streetDivision != ZoningPlan::StreetDivision::GRID_STREET_DIVIDED ) {
+        // No Block division
+        result.blocks.push_back( district->shape );
+        return result;
+    }
 
-        if ( plan->district.streetDivision != ZoningPlan::StreetDivision::GRID_STREET_DIVIDED ) {
-            // No Block division
-            district->blocks.push_back( Block::create( district->shape ) );
-            continue;
-        }
+    const std::vector<vec2> &outlinePoints = district->shape->outline().getPoints();
+    vector<CGAL::Polygon_2<ExactK>> roads;
 
-        const std::vector<vec2> outlinePoints = district->shape->outline().getPoints();
-        vector<CGAL::Polygon_2<ExactK>> roads;
+    // Create narrow roads to cover the bounding box
+    uint16_t angle = plan->district.grid.avenueAngle;
+    vector<seg2> dividers = computeDividers( outlinePoints, angle * M_PI / 180.0, plan->district.grid.avenueSpacing );
+    for ( auto &d : dividers ) {
+        roads.push_back( roadOutline( d.first, d.second, plan->district.grid.roadWidth ) );
+    }
 
-        // Create narrow roads to cover the bounding box
-        uint16_t angle = plan->district.grid.avenueAngle;
-        vector<seg2> dividers = computeDividers( outlinePoints, angle * M_PI / 180.0, plan->district.grid.avenueSpacing );
-        for ( auto &d : dividers ) {
-            roads.push_back( roadOutline( d.first, d.second, plan->district.grid.roadWidth ) );
-        }
+    // TODO move duplicated logic to a function
+    angle += plan->district.grid.streetAngle;
+    dividers = computeDividers( outlinePoints, angle * M_PI / 180.0, plan->district.grid.streetSpacing );
+    for ( auto &d : dividers ) {
+        roads.push_back( roadOutline( d.first, d.second, plan->district.grid.roadWidth ) );
+    }
 
-        // TODO move duplicated logic to a function
-        angle += plan->district.grid.streetAngle;
-        dividers = computeDividers( outlinePoints, angle * M_PI / 180.0, plan->district.grid.streetSpacing );
-        for ( auto &d : dividers ) {
-            roads.push_back( roadOutline( d.first, d.second, plan->district.grid.roadWidth ) );
-        }
+    auto districtWithHoles = district->shape->polygonWithHoles<ExactK>();
 
-        auto districtWithHoles = district->shape->polygonWithHoles<ExactK>();
+    CGAL::Polygon_set_2<ExactK> paved;
+    paved.join( roads.begin(), roads.end() );
+    // Find the intersection of the streets and block
+    paved.intersection( districtWithHoles );
 
-        CGAL::Polygon_set_2<ExactK> paved;
-        paved.join( roads.begin(), roads.end() );
-        // Find the intersection of the streets and block
-        paved.intersection( districtWithHoles );
+    // Add those as new streets.
+    list<CGAL::Polygon_with_holes_2<ExactK>> pavedShapes, unpavedShapes;
+    paved.polygons_with_holes( back_inserter( pavedShapes ) );
+    for ( auto &s : pavedShapes ) {
+        result.pavement.push_back( FlatShape::create( s ) );
+    }
 
-        // Add those as new streets.
-        list<CGAL::Polygon_with_holes_2<ExactK>> pavedShapes, unpavedShapes;
-        paved.polygons_with_holes( back_inserter( pavedShapes ) );
-        for ( auto &s : pavedShapes ) {
-// TODO: might be better for something else to collect up the streets from the
-// districts. then the districts have a clear way to remove their roads.
-            city.pavement.push_back( FlatShape::create( s ) );
+    // Find the unpaved chunks to break up with streets
+    CGAL::Polygon_set_2<ExactK> unpaved( districtWithHoles );
+    unpaved.difference( paved );
+    unpaved.polygons_with_holes( back_inserter( unpavedShapes ) );
+    for ( auto &s : unpavedShapes ) {
+        result.blocks.push_back( FlatShape::create( s ) );
+    }
+
+    return result;
+}
+
+// in Districts
+// out Streets, Blocks and paved FlatShape (on the district)
+void buildStreetsAndBlocks( CityModel &city )
+{
+    // The districts don't share anything so their grids can be worked out
+    // side by side...
+    vector<DistrictRef> districts;
+    for ( auto &district : city.districts ) {
+        if ( district->streetsKey != streetsKeyFor( *district->zoningPlan ) ) {
+            districts.push_back( district );
         }
+    }
+
+    vector<StreetGrid> grids( districts.size() );
+    parallelFor( districts.size(), [&]( size_t i ) {
+        grids[i] = buildStreetGrid( districts[i] );
+    } );
+
+    // ...but put together in district order so the block colors come out the
+    // same however many threads there were.
+    for ( size_t i = 0; i < districts.size(); ++i ) {
+        DistrictRef &district = districts[i];
+        StreetGrid &grid = grids[i];
 
-        // Find the unpaved chunks to break up with streets
-        CGAL::Polygon_set_2<ExactK> unpaved( districtWithHoles );
-        unpaved.difference( paved );
-        unpaved.polygons_with_holes( back_inserter( unpavedShapes ) );
-        for ( auto &s : unpavedShapes ) {
-            district->blocks.push_back( Block::create( FlatShape::create( s ) ) );
+        district->pavement = std::move( grid.pavement );
+        district->streetsKey = streetsKeyFor( *district->zoningPlan );
+
+        Arena::Scope scope( grid.arena );
+        district->blocks.clear();
+        district->blocks.reserve( grid.blocks.size() );
+        for ( auto &shape : grid.blocks ) {
+            district->blocks.push_back( Block::create( shape ) );
         }
     }
 }
@@ -0,0 +1,173 @@
+//
+//  Scenario.cpp
+//  Cityscape
+//
+//
+
+#include "Scenario.h"
+#include "ZoningPlanner.h"
+#include "RoadBuilder.h"
+
+#include "cinder/Rand.h"
+
+#include <sstream>
+
+using namespace ci;
+
+namespace Cityscape {
+
+bool parsePoint( const std::string &token, vec2 &point )
+{
+    std::istringstream stream( token );
+    char comma = 0;
+    stream >> point.x >> comma >> point.y;
+    return !stream.fail() && comma == ',' && stream.peek() == EOF;
+}
+
+bool loadScenario( std::istream &input, Scenario &scenario, std::string &error )
+{
+    std::string line;
+    size_t lineNumber = 0;
+    while ( std::getline( input, line ) ) {
+        ++lineNumber;
+        line = line.substr( 0, line.find( '#' ) );
+
+        std::istringstream words( line );
+        std::string keyword;
+        if ( !( words >> keyword ) ) continue;
+
+        auto fail = [&]( const std::string &message ) {
+            error = "line " + std::to_string( lineNumber ) + ": " + message;
+            return false;
+        };
+
+        if ( keyword == "seed" ) {
+            long long seed = -1;
+            if ( !( words >> seed ) || seed < 0 || seed > UINT32_MAX ) {
+                return fail( "seed needs a number from 0 to " + std::to_string( UINT32_MAX ) );
+            }
+            scenario.seed = static_cast<uint32_t>( seed );
+        }
+        else if ( keyword == "highway-width" ) {
+            int width = 0;
+            if ( !( words >> width ) || width < 1 || width > 255 ) {
+                return fail( "highway-width needs a number from 1 to 255" );
+            }
+            scenario.highwayWidth = width;
+        }
+        else if ( keyword == "zoning" ) {
+            std::string name;
+            while ( words >> name ) {
+                ZoningPlanRef plan = zoneNamed( name );
+                if ( !plan ) return fail( "unknown zoning plan '" + name + "'" );
+                scenario.zoningPlans.push_back( plan );
+            }
+        }
+        else if ( keyword == "highway" ) {
+            PolyLine2f highway;
+            std::string token;
+            while ( words >> token ) {
+                vec2 point;
+                if ( !parsePoint( token, point ) ) return fail( "expected x,y but got '" + token + "'" );
+                highway.push_back( point );
+            }
+            if ( highway.size() < 2 ) return fail( "a highway needs at least two points" );
+            scenario.highways.push_back( highway );
+        }
+        else {
+            return fail( "unknown setting '" + keyword + "'" );
+        }
+    }
+
+    if ( scenario.zoningPlans.empty() ) {
+        scenario.zoningPlans = { zoneFarming(), zoneMajesticHeights(), zoneDowntown() };
+    }
+
+    return true;
+}
+
+CityModel modelFrom( const Scenario &scenario )
+{
+    CityModel city( scenario.zoningPlans );
+    city.seed = scenario.seed;
+    city.highwayWidth = scenario.highwayWidth;
+    setHighways( city, scenario.highways );
+    return city;
+}
+
+std::vector<PolyLine2f> sampleHighways( int which )
+{
+    switch ( which ) {
+        case 1:
+            return {
+                PolyLine2f( {
+                    vec2( -154, -213 ),
+                    vec2( -144, 197 ),
+                    vec2( 208, 170 ),
+                    vec2( 83, 0 ),
+                    vec2( 242, -123 ),
+                } ),
+            };
+        case 2:
+            return {
+                PolyLine2f( {
+                    vec2( -154, -213 ),
+                    vec2( -144, 197 ),
+                    vec2( 208, 170 ),
+                    vec2( 83, 0 ),
+                    vec2( 242, -123 ),
+                } ),
+                PolyLine2f( {
+                    vec2( -156, -207 ),
+                    vec2( 236, -122 ),
+                } ),
+            };
+        case 3:
+            return {
+                PolyLine2f( {
+                    vec2( -9.6225, 498.446 ),
+                    vec2( -519.615,-336.788 ),
+                    vec2( 533.087,-159.734 ),
+                    vec2( -9.6225,498.446 ),
+                } ),
+            };
+        case 4:
+            return {
+                PolyLine2f( {
+                    vec2( -576, 575 ),
+                    vec2( 573, 572 ),
+                    vec2( 573, -569 ),
+                    vec2( -573, -578 ),
+                    vec2( -576, 575 ),
+                } ),
+            };
+        case 5:
+            return {
+                PolyLine2f( {
+                    vec2( -206.133, 539.26 ),
+                    vec2( -48.764, -527.973 ),
+                    vec2( 106.45, -568.06 ),
+                    vec2( 201.625, -478.988 ),
+                    vec2( 124.941, -249.35 ),
+                    vec2( 106.635, 485.66 ),
+                    vec2( -206.857, 500.64 ),
+                } ),
+            };
+    }
+    return {};
+}
+
+std::vector<PolyLine2f> randomHighways( size_t segments, const Rectf &bounds, uint32_t seed )
+{
+    Rand rand( seed );
+    std::vector<PolyLine2f> highways;
+    highways.reserve( segments );
+    for ( size_t i = 0; i < segments; ++i ) {
+        vec2 from( rand.nextFloat( bounds.x1, bounds.x2 ), rand.nextFloat( bounds.y1, bounds.y2 ) );
+        vec2 to( rand.nextFloat( bounds.x1, bounds.x2 ), rand.nextFloat( bounds.y1, bounds.y2 ) );
+        highways.push_back( PolyLine2f( { from, to } ) );
+    }
+    return highways;
+}
+
+} // Cityscape namespace
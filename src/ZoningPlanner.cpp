@@ -120,5 +120,13 @@ ZoningPlanRef zoneDowntown() {
     return downtown;
 }
 
+ZoningPlanRef zoneNamed( const std::string &name ) {
+    if ( name == "farming" )            return zoneFarming();
+    if ( name == "majestic-heights" )   return zoneMajesticHeights();
+    if ( name == "industrial" )         return zoneIndustrial();
+    if ( name == "downtown" )           return zoneDowntown();
+    return nullptr;
+}
+
 
 } // namespace Cityscape
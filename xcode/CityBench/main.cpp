@@ -0,0 +1,299 @@
+//
+//  main.cpp
+//  CityBench
+//
+//  Times each pipeline stage over a set of fixture cities of increasing size
+//  and reports how the cost grows with the number of districts, blocks and
+//  lots. Pass --json to get the results in a form a script can compare
+//  against an earlier run.
+//
+
+#include "CityData.h"
+#include "CityPipeline.h"
+#include "ParallelFor.h"
+#include "Scenario.h"
+#include "ZoningPlanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+
+using namespace Cityscape;
+
+struct Fixture {
+    std::string                 name;
+    std::vector<ci::PolyLine2f> highways;
+};
+
+struct StageTiming {
+    std::vector<double> samples;
+    double median = 0;
+    double p95 = 0;
+};
+
+struct FixtureResult {
+    std::string                 name;
+    size_t                      highways = 0;
+    CityStats                   stats;
+    std::vector<StageTiming>    stages;
+    StageTiming                 total;
+};
+
+const uint32_t  kSeed = 1;
+const ci::Rectf kRandomBounds( -600, -600, 600, 600 );
+
+std::vector<Fixture> fixtures()
+{
+    std::vector<Fixture> result;
+    for ( int i = 1; i <= 5; ++i ) {
+        result.push_back( { "test" + std::to_string( i ), sampleHighways( i ) } );
+    }
+    for ( size_t segments : { 10, 100, 1000 } ) {
+        result.push_back( { "random" + std::to_string( segments ), randomHighways( segments, kRandomBounds, kSeed ) } );
+    }
+    return result;
+}
+
+// Nearest rank percentile of sorted samples.
+double percentile( const std::vector<double> &sorted, double fraction )
+{
+    if ( sorted.empty() ) return 0;
+    size_t rank = static_cast<size_t>( std::ceil( fraction * sorted.size() ) );
+    return sorted[std::min( sorted.size(), std::max<size_t>( rank, 1 ) ) - 1];
+}
+
+void summarize( StageTiming &timing )
+{
+    std::vector<double> sorted = timing.samples;
+    std::sort( sorted.begin(), sorted.end() );
+    timing.median = percentile( sorted, 0.5 );
+    timing.p95 = percentile( sorted, 0.95 );
+}
+
+FixtureResult measure( const Fixture &fixture, size_t runs )
+{
+    const auto &stages = pipelineStages();
+
+    FixtureResult result;
+    result.name = fixture.name;
+    result.highways = fixture.highways.size();
+    result.stages.resize( stages.size() );
+
+    Scenario scenario;
+    scenario.seed = kSeed;
+    scenario.highways = fixture.highways;
+
+    for ( size_t run = 0; run < runs; ++run ) {
+        // Fresh plans each time, the pipeline hangs districts off of them.
+        scenario.zoningPlans = { zoneNamed( "farming" ), zoneNamed( "majestic-heights" ), zoneNamed( "downtown" ) };
+        CityModel city = modelFrom( scenario );
+
+        double total = 0;
+        for ( size_t i = 0; i < stages.size(); ++i ) {
+            auto start = std::chrono::steady_clock::now();
+            stages[i].run( city );
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            result.stages[i].samples.push_back( elapsed.count() );
+            total += elapsed.count();
+        }
+        result.total.samples.push_back( total );
+        result.stats = statsFor( city );
+    }
+
+    for ( auto &stage : result.stages ) summarize( stage );
+    summarize( result.total );
+
+    return result;
+}
+
+// Slope of the least squares fit of log(time) against log(count). Fixtures
+// that produced nothing to count, or too little time to measure, are skipped.
+// Returns NaN if fewer than two distinct counts are left.
+double scalingExponent( const std::vector<FixtureResult> &results, size_t stage, size_t CityStats::*count )
+{
+    std::vector<std::pair<double, double>> points;
+    for ( const auto &result : results ) {
+        double n = result.stats.*count;
+        double t = result.stages[stage].median;
+        if ( n > 0 && t > 0 ) points.push_back( { std::log( n ), std::log( t ) } );
+    }
+    if ( points.size() < 2 ) return std::numeric_limits<double>::quiet_NaN();
+
+    double meanX = 0, meanY = 0;
+    for ( const auto &p : points ) {
+        meanX += p.first;
+        meanY += p.second;
+    }
+    meanX /= points.size();
+    meanY /= points.size();
+
+    double sxx = 0, sxy = 0;
+    for ( const auto &p : points ) {
+        sxx += ( p.first - meanX ) * ( p.first - meanX );
+        sxy += ( p.first - meanX ) * ( p.second - meanY );
+    }
+    if ( sxx == 0 ) return std::numeric_limits<double>::quiet_NaN();
+    return sxy / sxx;
+}
+
+const std::vector<std::pair<std::string, size_t CityStats::*>>& scalingCounts()
+{
+    static const std::vector<std::pair<std::string, size_t CityStats::*>> counts = {
+        { "districts", &CityStats::districts },
+        { "blocks", &CityStats::blocks },
+        { "lots", &CityStats::lots },
+    };
+    return counts;
+}
+
+void printReport( std::ostream &out, const std::vector<FixtureResult> &results )
+{
+    const auto &stages = pipelineStages();
+
+    out << std::fixed;
+    for ( const auto &result : results ) {
+        out << result.name
+            << "  highways " << result.highways
+            << "  districts " << result.stats.districts
+            << "  blocks " << result.stats.blocks
+            << "  lots " << result.stats.lots << "\n";
+        out << std::setprecision( 4 );
+        for ( size_t i = 0; i < stages.size(); ++i ) {
+            out << "  " << std::left << std::setw( 28 ) << stages[i].name
+                << "median " << result.stages[i].median << "s  p95 " << result.stages[i].p95 << "s\n";
+        }
+        out << "  " << std::left << std::setw( 28 ) << "total"
+            << "median " << result.total.median << "s  p95 " << result.total.p95 << "s\n\n";
+    }
+
+    out << "scaling exponents\n" << std::setprecision( 2 );
+    for ( size_t i = 0; i < stages.size(); ++i ) {
+        out << "  " << std::left << std::setw( 28 ) << stages[i].name;
+        for ( const auto &count : scalingCounts() ) {
+            out << count.first << " " << scalingExponent( results, i, count.second ) << "  ";
+        }
+        out << "\n";
+    }
+}
+
+void writeNumber( std::ostream &out, double value )
+{
+    if ( std::isfinite( value ) ) out << value;
+    else out << "null";
+}
+
+void writeTiming( std::ostream &out, const StageTiming &timing )
+{
+    out << "{ \"median\": ";
+    writeNumber( out, timing.median );
+    out << ", \"p95\": ";
+    writeNumber( out, timing.p95 );
+    out << " }";
+}
+
+void writeJson( std::ostream &out, const std::vector<FixtureResult> &results, size_t runs )
+{
+    const auto &stages = pipelineStages();
+
+    out << std::setprecision( 9 );
+    out << "{\n  \"runs\": " << runs << ",\n  \"threads\": " << workerThreadCount() << ",\n  \"fixtures\": [\n";
+    for ( size_t f = 0; f < results.size(); ++f ) {
+        const auto &result = results[f];
+        out << "    {\n"
+            << "      \"name\": \"" << result.name << "\",\n"
+            << "      \"highways\": " << result.highways << ",\n"
+            << "      \"districts\": " << result.stats.districts << ",\n"
+            << "      \"blocks\": " << result.stats.blocks << ",\n"
+            << "      \"lots\": " << result.stats.lots << ",\n"
+            << "      \"buildings\": " << result.stats.buildings << ",\n"
+            << "      \"plants\": " << result.stats.plants << ",\n"
+            << "      \"stages\": {\n";
+        for ( size_t i = 0; i < stages.size(); ++i ) {
+            out << "        \"" << stages[i].name << "\": ";
+            writeTiming( out, result.stages[i] );
+            out << ",\n";
+        }
+        out << "        \"total\": ";
+        writeTiming( out, result.total );
+        out << "\n      }\n    }" << ( f + 1 < results.size() ? "," : "" ) << "\n";
+    }
+    out << "  ],\n  \"scaling\": {\n";
+    for ( size_t i = 0; i < stages.size(); ++i ) {
+        out << "    \"" << stages[i].name << "\": { ";
+        const auto &counts = scalingCounts();
+        for ( size_t c = 0; c < counts.size(); ++c ) {
+            out << "\"" << counts[c].first << "\": ";
+            writeNumber( out, scalingExponent( results, i, counts[c].second ) );
+            out << ( c + 1 < counts.size() ? ", " : " " );
+        }
+        out << "}" << ( i + 1 < stages.size() ? "," : "" ) << "\n";
+    }
+    out << "  }\n}\n";
+}
+
+int usage( const char *name )
+{
+    std::cerr << "usage: " << name << " [--runs N] [--threads N] [--only NAME] [--json results.json]\n";
+    return 2;
+}
+
+int main( int argc, const char *argv[] )
+{
+    size_t runs = 5;
+    std::string only;
+    std::string jsonPath;
+
+    for ( int i = 1; i < argc; ++i ) {
+        std::string arg = argv[i];
+        if ( i + 1 >= argc ) return usage( argv[0] );
+
+        if ( arg == "--runs" ) {
+            int value = std::atoi( argv[++i] );
+            if ( value < 1 ) return usage( argv[0] );
+            runs = value;
+        }
+        else if ( arg == "--threads" ) {
+            int value = std::atoi( argv[++i] );
+            if ( value < 1 ) return usage( argv[0] );
+            setWorkerThreadCount( value );
+        }
+        else if ( arg == "--only" ) {
+            only = argv[++i];
+        }
+        else if ( arg == "--json" ) {
+            jsonPath = argv[++i];
+        }
+        else {
+            return usage( argv[0] );
+        }
+    }
+
+    std::vector<FixtureResult> results;
+    for ( const auto &fixture : fixtures() ) {
+        if ( !only.empty() && fixture.name != only ) continue;
+        results.push_back( measure( fixture, runs ) );
+    }
+    if ( results.empty() ) {
+        std::cerr << "no fixture named " << only << "\n";
+        return 1;
+    }
+
+    std::cout << workerThreadCount() << " threads, " << runs << " runs\n\n";
+    printReport( std::cout, results );
+
+    if ( !jsonPath.empty() ) {
+        std::ofstream file( jsonPath );
+        if ( !file ) {
+            std::cerr << "unable to write " << jsonPath << "\n";
+            return 1;
+        }
+        writeJson( file, results, runs );
+    }
+
+    return 0;
+}
@@ -0,0 +1,74 @@
+//
+//  main.cpp
+//  CityGen
+//
+//  Runs the city generation pipeline without opening a window so it can be
+//  timed and profiled on its own.
+//
+
+#include "CityData.h"
+#include "CityPipeline.h"
+#include "BuildingPlanCache.h"
+#include "Scenario.h"
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+using namespace Cityscape;
+
+int usage( const char *name )
+{
+    std::cerr << "usage: " << name << " scenario.txt\n";
+    return 2;
+}
+
+int main( int argc, const char *argv[] )
+{
+    if ( argc != 2 ) return usage( argv[0] );
+
+    const std::string path = argv[1];
+    std::ifstream file( path );
+    if ( !file ) {
+        std::cerr << "unable to open " << path << "\n";
+        return 1;
+    }
+
+    Scenario scenario;
+    std::string error;
+    if ( !loadScenario( file, scenario, error ) ) {
+        std::cerr << path << ": " << error << "\n";
+        return 1;
+    }
+
+    CityModel city = modelFrom( scenario );
+
+    std::cout << "scenario " << path << "\n";
+    std::cout << std::fixed << std::setprecision( 3 );
+
+    double total = 0;
+    for ( const auto &stage : pipelineStages() ) {
+        auto start = std::chrono::steady_clock::now();
+        stage.run( city );
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        total += elapsed.count();
+
+        std::cout << std::left << std::setw( 28 ) << stage.name << elapsed.count() << "s\n";
+    }
+    std::cout << std::left << std::setw( 28 ) << "total" << total << "s\n";
+
+    CityStats stats = statsFor( city );
+    BuildingPlanCache::Stats plans = BuildingPlanCache::shared().stats();
+    std::cout << "\n"
+        << "highways  " << city.highways.size() << "\n"
+        << "districts " << stats.districts << "\n"
+        << "blocks    " << stats.blocks << "\n"
+        << "lots      " << stats.lots << "\n"
+        << "buildings " << stats.buildings << "\n"
+        << "plants    " << stats.plants << "\n"
+        << "building plans " << plans.size << " (" << plans.hits << " hits, " << plans.misses << " misses)\n"
+        << "peak memory " << std::setprecision( 1 ) << peakMemoryUsage() / ( 1024.0 * 1024.0 ) << " MB\n";
+
+    return 0;
+}
@@ -266,3 +266,76 @@ TEST_CASE( "anglesBetweenPointsIn", "[foo]" ) {
     }
 
 }
+
+TEST_CASE( "outlinesMatch", "[foo]" ) {
+    std::vector<vec2> a = { vec2( 0, 0 ), vec2( 10, 0 ), vec2( 10, 10 ) };
+
+    SECTION( "within the tolerance" ) {
+        std::vector<vec2> b = { vec2( 0.004, 0 ), vec2( 10, -0.006 ), vec2( 9.995, 10.005 ) };
+        REQUIRE( outlinesMatch( a, b ) );
+    }
+
+    SECTION( "a point too far off" ) {
+        std::vector<vec2> b = { vec2( 0, 0 ), vec2( 10, 0.02 ), vec2( 10, 10 ) };
+        REQUIRE_FALSE( outlinesMatch( a, b ) );
+    }
+
+    SECTION( "different sizes" ) {
+        std::vector<vec2> b = { vec2( 0, 0 ), vec2( 10, 0 ) };
+        REQUIRE_FALSE( outlinesMatch( a, b ) );
+    }
+}
+
+TEST_CASE( "canonicalOutline", "[foo]" ) {
+    PolyLine2f input( { vec2( 0, 0 ), vec2( 40, 0 ), vec2( 40, 20 ), vec2( 10, 30 ), vec2( 0, 20 ), vec2( 0, 0 ) } );
+    vec2 origin;
+    float rotation;
+    PolyLine2f canonical = canonicalOutline( input, origin, rotation );
+
+    SECTION( "centered on the origin" ) {
+        REQUIRE( canonical.size() == input.size() );
+        REQUIRE( canonical.getPoints().front() == canonical.getPoints().back() );
+
+        vec2 centroid = canonical.calcCentroid();
+        REQUIRE( centroid.x == Approx( 0 ).epsilon( 0.01 ) );
+        REQUIRE( centroid.y == Approx( 0 ).epsilon( 0.01 ) );
+    }
+
+    SECTION( "longest edge on the x-axis" ) {
+        const auto &points = canonical.getPoints();
+        REQUIRE( points[0].y == Approx( points[1].y ) );
+        REQUIRE( points[1].x - points[0].x == Approx( 40 ) );
+    }
+
+    SECTION( "moved and turned copies match" ) {
+        // The BuildingPlanCache shares a plan between outlines that pass
+        // outlinesMatch(), so every copy has to.
+        for ( float angle : { 0.3f, 1.2f, 2.9f, 4.4f } ) {
+            for ( vec2 offset : { vec2( -300, 150 ), vec2( 0.005, -0.005 ), vec2( 1234.567, 89.123 ) } ) {
+                mat3 matrix = rotate( translate( mat3(), offset ), angle );
+                PolyLine2f moved;
+                for ( const vec2 &p : input ) {
+                    moved.push_back( vec2( matrix * vec3( p, 1 ) ) );
+                }
+
+                vec2 movedOrigin;
+                float movedRotation;
+                PolyLine2f movedCanonical = canonicalOutline( moved, movedOrigin, movedRotation );
+
+                REQUIRE( outlinesMatch( movedCanonical.getPoints(), canonical.getPoints() ) );
+                REQUIRE( glm::distance( movedOrigin, vec2( matrix * vec3( origin, 1 ) ) ) < 0.01f );
+            }
+        }
+    }
+
+    SECTION( "origin and rotation put it back" ) {
+        mat3 matrix = rotate( translate( mat3(), origin ), rotation );
+        for ( const vec2 &p : canonical ) {
+            vec2 restored( matrix * vec3( p, 1 ) );
+            bool found = std::any_of( input.begin(), input.end(), [&]( const vec2 &q ) {
+                return glm::distance( restored, q ) < 0.02f;
+            } );
+            REQUIRE( found );
+        }
+    }
+}
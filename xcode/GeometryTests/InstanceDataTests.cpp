@@ -0,0 +1,86 @@
+//
+//  InstanceDataTests.cpp
+//  Cityscape
+//
+//
+
+#include "catch.hpp"
+#include "cinder/Cinder.h"
+
+#include "InstanceData.h"
+#include "Scenery.h"
+
+using namespace ci;
+
+// Halves round to 11 bits so allow a little more than that, relative to the
+// size of each axis.
+void requireClose( const mat4 &actual, const mat4 &expected )
+{
+    for ( int i = 0; i < 4; ++i ) {
+        float allowed = 2e-3f * std::max( 1.0f, glm::length( expected[i] ) );
+        REQUIRE( glm::distance( actual[i], expected[i] ) <= allowed );
+    }
+}
+
+void requirePacks( const mat4 &transform )
+{
+    auto packed = InstanceData::pack( transform, ColorA::white() );
+    REQUIRE( packed );
+    requireClose( packed->matrix(), transform );
+}
+
+TEST_CASE( "InstanceData", "[foo]" ) {
+    const vec2 at( 1234.5, -678.9 );
+
+    SECTION( "park and orchard trees" ) {
+        for ( float diameter : { 4.0f, 7.5f, 12.0f, 17.3f, 20.0f } ) {
+            requirePacks( SphereTree::buildMatrix( at, diameter ) );
+        }
+    }
+
+    SECTION( "cone trees" ) {
+        for ( float diameter : { 5.0f, 7.7f, 10.0f } ) {
+            for ( float ratio : { 1.0f, 2.3f, 3.0f } ) {
+                requirePacks( ConeTree::buildMatrix( at, diameter, diameter * ratio ) );
+            }
+        }
+    }
+
+    SECTION( "crop rows" ) {
+        for ( float angle : { 0.0f, 0.4f, 1.7f, 3.1f, 5.9f } ) {
+            vec2 end = at + vec2( cos( angle ), sin( angle ) ) * 85.3f;
+            requirePacks( RowCrop::buildMatrix( at, end, 2.5f ) );
+        }
+    }
+
+    SECTION( "buildings" ) {
+        for ( float angle : { 0.0f, 0.4f, 1.7f, 3.1f, 5.9f } ) {
+            requirePacks( Scenery::buildMatrix( vec3( at, 0 ), angle ) );
+        }
+    }
+
+    SECTION( "mirrored" ) {
+        requirePacks( glm::scale( Scenery::buildMatrix( vec3( at, 0 ), 0.8f ), vec3( 3, -2, 1 ) ) );
+    }
+
+    SECTION( "tilted or sheared" ) {
+        REQUIRE_FALSE( InstanceData::pack( glm::rotate( mat4(), 0.3f, vec3( 1, 0, 0 ) ), ColorA::white() ) );
+
+        mat4 sheared;
+        sheared[1][0] = 0.5f;
+        REQUIRE_FALSE( InstanceData::pack( sheared, ColorA::white() ) );
+    }
+
+    SECTION( "too big for a half" ) {
+        REQUIRE_FALSE( InstanceData::pack( glm::scale( vec3( 100000, 1, 1 ) ), ColorA::white() ) );
+    }
+
+    SECTION( "colors" ) {
+        ColorA color( 0.41f, 0.60f, 0.22f, 0.75f );
+        vec4 rgba = InstanceData::pack( mat4(), color )->rgba();
+        REQUIRE( rgba.r == Approx( color.r ).epsilon( 1 / 255.0 ) );
+        REQUIRE( rgba.g == Approx( color.g ).epsilon( 1 / 255.0 ) );
+        REQUIRE( rgba.b == Approx( color.b ).epsilon( 1 / 255.0 ) );
+        REQUIRE( rgba.a == Approx( color.a ).epsilon( 1 / 255.0 ) );
+    }
+}